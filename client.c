@@ -36,6 +36,7 @@
 struct imsgbuf	client_ibuf;
 struct event	client_event;
 struct event	client_stdin;
+int		client_stdin_file;
 enum {
 	CLIENT_EXIT_NONE,
 	CLIENT_EXIT_DETACHED,
@@ -49,16 +50,19 @@ enum {
 int		client_exitval;
 enum msgtype	client_exittype;
 int		client_attached;
+int		client_flags;
 
 int		client_get_lock(char *);
 int		client_connect(char *, int);
-void		client_send_identify(int);
+void		client_send_identify(int, int);
 void		client_send_environ(void);
 void		client_write_server(enum msgtype, void *, size_t);
 void		client_update_event(void);
 void		client_signal(int, short, void *);
+void		client_stdin_add(void);
 void		client_stdin_callback(int, short, void *);
 void		client_write(int, const char *, size_t);
+void		client_write_pipe(int, int);
 void		client_callback(int, short, void *);
 int		client_dispatch_attached(void);
 int		client_dispatch_wait(void *);
@@ -166,17 +170,33 @@ client_main(int argc, char **argv, int flags)
 	struct cmd		*cmd;
 	struct cmd_list		*cmdlist;
 	struct msg_command_data	 cmddata;
-	int			 cmdflags, fd;
+	struct stat		 sb;
+	int			 cmdflags, fd, sendtty;
 	pid_t			 ppid;
 	enum msgtype		 msg;
 	char			*cause;
 	struct termios		 tio, saved_tio;
-
 	/* Set up the initial command. */
 	cmdflags = 0;
 	if (shell_cmd != NULL) {
 		msg = MSG_SHELL;
 		cmdflags = CMD_STARTSERVER;
+	} else if (batch_file != NULL) {
+		/* Commands come on stdin once the server asks for it. */
+		msg = MSG_STDIN;
+		cmdflags = CMD_STARTSERVER;
+		flags |= IDENTIFY_BATCH;
+
+		if (strcmp(batch_file, "-") != 0) {
+			if ((fd = open(batch_file, O_RDONLY)) == -1) {
+				fprintf(stderr, "%s: %s\n", batch_file,
+				    strerror(errno));
+				return (1);
+			}
+			if (dup2(fd, STDIN_FILENO) == -1)
+				fatal("dup2 failed");
+			close(fd);
+		}
 	} else if (argc == 0) {
 		msg = MSG_COMMAND;
 		cmdflags = CMD_STARTSERVER|CMD_SENDENVIRON|CMD_CANTNEST;
@@ -235,8 +255,14 @@ client_main(int argc, char **argv, int flags)
 
 	/* Create stdin handler. */
 	setblocking(STDIN_FILENO, 0);
-	event_set(&client_stdin, STDIN_FILENO, EV_READ|EV_PERSIST,
-	    client_stdin_callback, NULL);
+	if (fstat(STDIN_FILENO, &sb) == 0 && S_ISREG(sb.st_mode)) {
+		/* Regular files can't be polled, so read them from a timer. */
+		client_stdin_file = 1;
+		evtimer_set(&client_stdin, client_stdin_callback, NULL);
+	} else {
+		event_set(&client_stdin, STDIN_FILENO, EV_READ|EV_PERSIST,
+		    client_stdin_callback, NULL);
+	}
 	if (flags & IDENTIFY_TERMIOS) {
 		if (tcgetattr(STDIN_FILENO, &saved_tio) != 0) {
 			fprintf(stderr, "tcgetattr failed: %s\n",
@@ -260,10 +286,20 @@ client_main(int argc, char **argv, int flags)
 	/* Establish signal handlers. */
 	set_signals(client_signal);
 
-	/* Send initial environment. */
-	if (cmdflags & CMD_SENDENVIRON)
+	/*
+	 * Send initial environment. Only clients which may attach need it or
+	 * the terminal; for others the terminal is sent only if stdin is one,
+	 * so the server can refuse to read from it.
+	 */
+	if (cmdflags & CMD_SENDENVIRON) {
 		client_send_environ();
-	client_send_identify(flags);
+		sendtty = 1;
+	} else if (flags & (IDENTIFY_CONTROL|IDENTIFY_BATCH))
+		sendtty = 0;
+	else
+		sendtty = isatty(STDIN_FILENO);
+	client_flags = flags;
+	client_send_identify(flags, sendtty);
 
 	/* Send first command. */
 	if (msg == MSG_COMMAND) {
@@ -301,9 +337,9 @@ client_main(int argc, char **argv, int flags)
 	return (client_exitval);
 }
 
-/* Send identify message to server with the file descriptors. */
+/* Send identify message to server with the terminal, if wanted. */
 void
-client_send_identify(int flags)
+client_send_identify(int flags, int sendtty)
 {
 	struct msg_identify_data	data;
 	char			       *term;
@@ -314,13 +350,17 @@ client_send_identify(int flags)
 	if (getcwd(data.cwd, sizeof data.cwd) == NULL)
 		*data.cwd = '\0';
 
-	term = getenv("TERM");
-	if (term == NULL ||
-	    strlcpy(data.term, term, sizeof data.term) >= sizeof data.term)
-		*data.term = '\0';
+	*data.term = '\0';
+	fd = -1;
+	if (sendtty) {
+		term = getenv("TERM");
+		if (term != NULL && strlcpy(data.term, term,
+		    sizeof data.term) >= sizeof data.term)
+			*data.term = '\0';
 
-	if ((fd = dup(STDIN_FILENO)) == -1)
-		fatal("dup failed");
+		if ((fd = dup(STDIN_FILENO)) == -1)
+			fatal("dup failed");
+	}
 	imsg_compose(&client_ibuf,
 	    MSG_IDENTIFY, PROTOCOL_VERSION, -1, fd, &data, sizeof data);
 	client_update_event();
@@ -445,20 +485,39 @@ lost_server:
 	event_loopexit(NULL);
 }
 
+/* Start reading stdin. */
+void
+client_stdin_add(void)
+{
+	struct timeval	tv;
+
+	if (client_stdin_file) {
+		timerclear(&tv);
+		evtimer_add(&client_stdin, &tv);
+	} else
+		event_add(&client_stdin, NULL);
+}
+
 /* Callback for client stdin read events. */
 /* ARGSUSED */
 void
 client_stdin_callback(unused int fd, unused short events, unused void *data1)
 {
-	struct msg_stdin_data	data;
+	char	buf[MSG_DATA_SIZE];
+	ssize_t	n;
 
-	data.size = read(STDIN_FILENO, data.data, sizeof data.data);
-	if (data.size < 0 && (errno == EINTR || errno == EAGAIN))
+	n = read(STDIN_FILENO, buf, sizeof buf);
+	if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+		if (client_stdin_file)
+			client_stdin_add();
 		return;
+	}
 
-	client_write_server(MSG_STDIN, &data, sizeof data);
-	if (data.size <= 0)
+	client_write_server(MSG_STDIN, buf, n > 0 ? n : 0);
+	if (n <= 0)
 		event_del(&client_stdin);
+	else if (client_stdin_file)
+		client_stdin_add();
 	client_update_event();
 }
 
@@ -480,6 +539,25 @@ client_write(int fd, const char *data, size_t size)
 	}
 }
 
+/* Copy a pipe from the server to a file descriptor until it is closed. */
+void
+client_write_pipe(int fd, int to)
+{
+	char	buf[BUFSIZ * 4];
+	ssize_t	n;
+
+	setblocking(fd, 1);
+	for (;;) {
+		n = read(fd, buf, sizeof buf);
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		client_write(to, buf, n);
+	}
+	close(fd);
+}
+
 /* Dispatch imsgs when in wait state (before MSG_READY). */
 int
 client_dispatch_wait(void *data)
@@ -488,8 +566,7 @@ client_dispatch_wait(void *data)
 	ssize_t			n, datalen;
 	struct msg_shell_data	shelldata;
 	struct msg_exit_data	exitdata;
-	struct msg_stdout_data	stdoutdata;
-	struct msg_stderr_data	stderrdata;
+	int			fd;
 	const char             *shellcmd = data;
 
 	for (;;) {
@@ -523,21 +600,37 @@ client_dispatch_wait(void *data)
 			if (datalen != 0)
 				fatalx("bad MSG_STDIN size");
 
-			event_add(&client_stdin, NULL);
+			/*
+			 * Batch and control clients send stdin as they read
+			 * it; others hand it over for the server to read.
+			 */
+			if (client_flags & (IDENTIFY_CONTROL|IDENTIFY_BATCH)) {
+				client_stdin_add();
+				break;
+			}
+			if ((fd = dup(STDIN_FILENO)) == -1) {
+				/* Without a descriptor, tell it stdin is done. */
+				client_write_server(MSG_STDIN, NULL, 0);
+				break;
+			}
+			imsg_compose(&client_ibuf,
+			    MSG_STDIN, PROTOCOL_VERSION, -1, fd, NULL, 0);
+			client_update_event();
 			break;
 		case MSG_STDOUT:
-			if (datalen != sizeof stdoutdata)
-				fatalx("bad MSG_STDOUT");
-			memcpy(&stdoutdata, imsg.data, sizeof stdoutdata);
+			if ((size_t) datalen > MSG_DATA_SIZE)
+				fatalx("bad MSG_STDOUT size");
 
-			client_write(STDOUT_FILENO, stdoutdata.data, stdoutdata.size);
+			if (imsg.fd != -1)
+				client_write_pipe(imsg.fd, STDOUT_FILENO);
+			else
+				client_write(STDOUT_FILENO, imsg.data, datalen);
 			break;
 		case MSG_STDERR:
-			if (datalen != sizeof stderrdata)
-				fatalx("bad MSG_STDERR");
-			memcpy(&stderrdata, imsg.data, sizeof stderrdata);
+			if ((size_t) datalen > MSG_DATA_SIZE)
+				fatalx("bad MSG_STDERR size");
 
-			client_write(STDERR_FILENO, stderrdata.data, stderrdata.size);
+			client_write(STDERR_FILENO, imsg.data, datalen);
 			break;
 		case MSG_VERSION:
 			if (datalen != 0)
@@ -17,23 +17,61 @@
  */
 
 #include <sys/types.h>
+#include <sys/stat.h>
 
+#include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "tmux.h"
 
 /*
- * Write the entire contents of a pane to a buffer.
+ * Write the entire contents of a pane to a buffer, or stream it to the
+ * client's stdout or a file.
  */
 
+/* Lines added each time round the loop when streaming. */
+#define CAPTURE_PANE_LINES 1000
+
+/* Wait until there is less than this waiting for stdout or the file. */
+#define CAPTURE_PANE_WAITING 65536
+
+struct cmd_capture_pane_data {
+	struct cmd_ctx		 ctx;
+	u_int			 pane;
+
+	/* Lines to write, counting lines removed from the history. */
+	u_int			 line;
+	u_int			 last;
+
+	int			 codes;
+	struct grid_cell	 lastgc;
+
+	int			 changed;
+	unsigned long long	 since;
+
+	int			 fd;
+	struct evbuffer		*buffer;
+	struct event		 event;		/* file is ready for writing */
+	struct event		 timer;
+};
+
 enum cmd_retval	 cmd_capture_pane_exec(struct cmd *, struct cmd_ctx *);
 
+int	cmd_capture_pane_open(struct cmd_ctx *, const char *);
+void	cmd_capture_pane_lines(struct cmd_capture_pane_data *,
+	    struct window_pane *, struct evbuffer *);
+void	cmd_capture_pane_callback(int, short, void *);
+int	cmd_capture_pane_flush(struct cmd_capture_pane_data *);
+void	cmd_capture_pane_free(struct cmd_capture_pane_data *);
+
 const struct cmd_entry cmd_capture_pane_entry = {
 	"capture-pane", "capturep",
-	"b:E:S:t:", 0, 0,
-	"[-b buffer-index] [-E end-line] [-S start-line] "
-	CMD_TARGET_PANE_USAGE,
+	"b:eE:f:g:pS:t:", 0, 0,
+	"[-ep] [-b buffer-index] [-E end-line] [-f file] [-g generation] "
+	"[-S start-line] " CMD_TARGET_PANE_USAGE,
 	0,
 	NULL,
 	NULL,
@@ -43,23 +81,24 @@ const struct cmd_entry cmd_capture_pane_entry = {
 enum cmd_retval
 cmd_capture_pane_exec(struct cmd *self, struct cmd_ctx *ctx)
 {
-	struct args		*args = self->args;
-	struct window_pane	*wp;
-	char 			*buf, *line, *cause;
-	struct screen		*s;
-	struct grid		*gd;
-	int			 buffer, n;
-	u_int			 i, limit, top, bottom, tmp;
-	size_t         		 len, linelen;
+	struct args			*args = self->args;
+	struct client			*c = ctx->cmdclient;
+	struct window_pane		*wp;
+	struct cmd_capture_pane_data	 data, *cdata;
+	struct evbuffer			*evb;
+	struct timeval			 tv;
+	char 				*buf, *cause;
+	struct screen			*s;
+	struct grid			*gd;
+	int				 buffer, n, fd;
+	u_int				 limit, top, bottom, tmp;
+	size_t         			 len;
 
 	if (cmd_find_pane(ctx, args_get(args, 't'), NULL, &wp) == NULL)
 		return (CMD_RETURN_ERROR);
 	s = &wp->base;
 	gd = s->grid;
 
-	buf = NULL;
-	len = 0;
-
 	n = args_strtonum(args, 'S', INT_MIN, SHRT_MAX, &cause);
 	if (cause != NULL) {
 		top = gd->hsize;
@@ -88,18 +127,102 @@ cmd_capture_pane_exec(struct cmd *self, struct cmd_ctx *ctx)
 		top = tmp;
 	}
 
-	for (i = top; i <= bottom; i++) {
-	       line = grid_string_cells(s->grid, 0, i, screen_size_x(s));
-	       linelen = strlen(line);
+	if (args_has(args, 'f') && args_has(args, 'p')) {
+		ctx->error(ctx, "can't use -f with -p");
+		return (CMD_RETURN_ERROR);
+	}
+
+	memset(&data, 0, sizeof data);
+	memcpy(&data.ctx, ctx, sizeof data.ctx);
+	data.pane = wp->id;
+	data.line = gd->hremoved + top;
+	data.last = gd->hremoved + bottom;
+	data.codes = args_has(args, 'e');
+	memcpy(&data.lastgc, &grid_default_cell, sizeof data.lastgc);
+	data.fd = -1;
+
+	/*
+	 * With -g, only lines changed since the given generation are wanted.
+	 * The first line is the current generation and the number of the top
+	 * visible line, and each changed line starts with its number. Lines
+	 * are numbered from the start of the pane so the numbers do not change
+	 * as it scrolls.
+	 */
+	evb = evbuffer_new();
+	if (args_has(args, 'g')) {
+		data.changed = 1;
+		data.since = args_strtonum(args, 'g', 0, LLONG_MAX, &cause);
+		if (cause != NULL) {
+			ctx->error(ctx, "generation %s", cause);
+			free(cause);
+			evbuffer_free(evb);
+			return (CMD_RETURN_ERROR);
+		}
+		evbuffer_add_printf(evb, "%llu %u\n", gd->generation,
+		    gd->hremoved + gd->hsize);
+	}
+
+	/*
+	 * Printing with no client to write to (from control mode or a key
+	 * binding) goes through the normal command output.
+	 */
+	if (args_has(args, 'p') && c == NULL) {
+		while (data.line <= data.last) {
+			cmd_capture_pane_lines(&data, wp, evb);
+			if (EVBUFFER_LENGTH(evb) == 0)
+				continue;
+			ctx->print(ctx, "%.*s", (int) EVBUFFER_LENGTH(evb) - 1,
+			    EVBUFFER_DATA(evb));
+			evbuffer_drain(evb, EVBUFFER_LENGTH(evb));
+		}
+		evbuffer_free(evb);
+		return (CMD_RETURN_NORMAL);
+	}
+
+	/*
+	 * Otherwise with -f or -p, write the lines a few at a time from a
+	 * timer so a large capture does not hold up the server.
+	 */
+	if (args_has(args, 'f') || args_has(args, 'p')) {
+		if (args_has(args, 'f')) {
+			fd = cmd_capture_pane_open(ctx, args_get(args, 'f'));
+			if (fd == -1) {
+				evbuffer_free(evb);
+				return (CMD_RETURN_ERROR);
+			}
+			data.fd = fd;
+			data.buffer = evb;
+		} else {
+			evbuffer_add_buffer(c->stdout_data, evb);
+			evbuffer_free(evb);
+		}
 
-	       buf = xrealloc(buf, 1, len + linelen + 1);
-	       memcpy(buf + len, line, linelen);
-	       len += linelen;
-	       buf[len++] = '\n';
+		cdata = xmalloc(sizeof *cdata);
+		memcpy(cdata, &data, sizeof *cdata);
+		if (ctx->cmdclient != NULL)
+			ctx->cmdclient->references++;
+		if (ctx->curclient != NULL)
+			ctx->curclient->references++;
 
-	       free(line);
+		if (cdata->fd != -1) {
+			event_set(&cdata->event, cdata->fd, EV_WRITE,
+			    cmd_capture_pane_callback, cdata);
+		}
+		evtimer_set(&cdata->timer, cmd_capture_pane_callback, cdata);
+		event_priority_set(&cdata->timer, EVENT_PRIORITY_OUTPUT);
+		timerclear(&tv);
+		evtimer_add(&cdata->timer, &tv);
+
+		return (CMD_RETURN_YIELD);	/* don't let client exit */
 	}
 
+	while (data.line <= data.last)
+		cmd_capture_pane_lines(&data, wp, evb);
+	len = EVBUFFER_LENGTH(evb);
+	buf = xmalloc(len + 1);
+	memcpy(buf, EVBUFFER_DATA(evb), len);
+	evbuffer_free(evb);
+
 	limit = options_get_number(&global_options, "buffer-limit");
 
 	if (!args_has(args, 'b')) {
@@ -123,3 +246,179 @@ cmd_capture_pane_exec(struct cmd *self, struct cmd_ctx *ctx)
 
 	return (CMD_RETURN_NORMAL);
 }
+
+/* Open the file to write to, relative to the client's working directory. */
+int
+cmd_capture_pane_open(struct cmd_ctx *ctx, const char *path)
+{
+	struct client	*c = ctx->cmdclient;
+	struct session	*s;
+	const char	*wd;
+	char		*newpath;
+	mode_t		 mask;
+	int		 fd;
+
+	if (c != NULL)
+		wd = c->cwd;
+	else if ((s = cmd_current_session(ctx, 0)) != NULL) {
+		wd = options_get_string(&s->options, "default-path");
+		if (*wd == '\0')
+			wd = s->cwd;
+	} else
+		wd = NULL;
+	if (*path != '/' && wd != NULL && *wd != '\0')
+		xasprintf(&newpath, "%s/%s", wd, path);
+	else
+		newpath = xstrdup(path);
+
+	mask = umask(S_IRWXG | S_IRWXO);
+	fd = open(newpath, O_WRONLY|O_CREAT|O_TRUNC|O_NONBLOCK, 0666);
+	umask(mask);
+	if (fd == -1)
+		ctx->error(ctx, "%s: %s", newpath, strerror(errno));
+	free(newpath);
+	return (fd);
+}
+
+/*
+ * Add up to the next CAPTURE_PANE_LINES lines to a buffer, each ending in a
+ * newline. With escape sequences, each line ends with the attributes and
+ * colours reset.
+ */
+void
+cmd_capture_pane_lines(struct cmd_capture_pane_data *cdata,
+    struct window_pane *wp, struct evbuffer *evb)
+{
+	struct grid		*gd = wp->base.grid;
+	struct grid_cell	*gcp;
+	u_int			 n, py;
+
+	/*
+	 * Lines may have been removed from the history since the last time, so
+	 * work out where the next line is now. Any that are gone are skipped.
+	 */
+	if (cdata->line < gd->hremoved)
+		cdata->line = gd->hremoved;
+	if (cdata->last >= gd->hremoved + gd->hsize + gd->sy)
+		cdata->last = gd->hremoved + gd->hsize + gd->sy - 1;
+
+	gcp = cdata->codes ? &cdata->lastgc : NULL;
+	for (n = 0; n < CAPTURE_PANE_LINES; n++) {
+		if (cdata->line > cdata->last)
+			break;
+		py = cdata->line++ - gd->hremoved;
+
+		if (cdata->changed) {
+			if (gd->linedata[py].generation <= cdata->since)
+				continue;
+			evbuffer_add_printf(evb, "%u ", gd->hremoved + py);
+		}
+		grid_string_line(gd, py, screen_size_x(&wp->base), evb, gcp);
+		if (gcp != NULL)
+			grid_string_code(&grid_default_cell, gcp, evb);
+		evbuffer_add(evb, "\n", 1);
+	}
+}
+
+/* Write the next lines of a streaming capture. */
+/* ARGSUSED */
+void
+cmd_capture_pane_callback(unused int fd, unused short events, void *data)
+{
+	struct cmd_capture_pane_data	*cdata = data;
+	struct client			*c = cdata->ctx.cmdclient;
+	struct window_pane		*wp;
+	struct evbuffer			*evb;
+	struct timeval			 tv;
+
+	if (c != NULL && (c->flags & CLIENT_DEAD)) {
+		cmd_capture_pane_free(cdata);
+		return;
+	}
+	/*
+	 * If the file will not take what is already waiting, carry on when it
+	 * is ready rather than building up more.
+	 */
+	if (cdata->fd != -1) {
+		if (cmd_capture_pane_flush(cdata) != 0) {
+			cmd_capture_pane_free(cdata);
+			return;
+		}
+		if (EVBUFFER_LENGTH(cdata->buffer) >= CAPTURE_PANE_WAITING ||
+		    (EVBUFFER_LENGTH(cdata->buffer) != 0 &&
+		    cdata->line > cdata->last)) {
+			event_add(&cdata->event, NULL);
+			return;
+		}
+	}
+	if (cdata->line > cdata->last) {
+		cmd_capture_pane_free(cdata);
+		return;
+	}
+
+	if ((wp = window_pane_find_by_id(cdata->pane)) == NULL) {
+		cdata->ctx.error(&cdata->ctx, "pane has gone away");
+		cmd_capture_pane_free(cdata);
+		return;
+	}
+
+	if (cdata->fd == -1) {
+		evb = c->stdout_data;
+		if (EVBUFFER_LENGTH(evb) >= CAPTURE_PANE_WAITING)
+			goto again;
+	} else
+		evb = cdata->buffer;
+	cmd_capture_pane_lines(cdata, wp, evb);
+
+	if (cdata->fd == -1) {
+		server_push_stdout(c);
+		if (cdata->line > cdata->last) {
+			cmd_capture_pane_free(cdata);
+			return;
+		}
+	}
+
+again:
+	timerclear(&tv);
+	evtimer_add(&cdata->timer, &tv);
+}
+
+/* Write as much as the file will take of what is waiting for it. */
+int
+cmd_capture_pane_flush(struct cmd_capture_pane_data *cdata)
+{
+	while (EVBUFFER_LENGTH(cdata->buffer) != 0) {
+		if (evbuffer_write(cdata->buffer, cdata->fd) == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN)
+				break;
+			cdata->ctx.error(&cdata->ctx, "write error: %s",
+			    strerror(errno));
+			return (-1);
+		}
+	}
+	return (0);
+}
+
+void
+cmd_capture_pane_free(struct cmd_capture_pane_data *cdata)
+{
+	struct cmd_ctx	*ctx = &cdata->ctx;
+
+	if (ctx->cmdclient != NULL) {
+		ctx->cmdclient->references--;
+		ctx->cmdclient->flags |= CLIENT_EXIT;
+	}
+	if (ctx->curclient != NULL)
+		ctx->curclient->references--;
+
+	evtimer_del(&cdata->timer);
+	if (cdata->fd != -1) {
+		event_del(&cdata->event);
+		close(cdata->fd);
+	}
+	if (cdata->buffer != NULL)
+		evbuffer_free(cdata->buffer);
+	free(cdata);
+}
@@ -17,6 +17,7 @@
  */
 
 #include <sys/types.h>
+#include <sys/time.h>
 
 #include <fnmatch.h>
 #include <stdlib.h>
@@ -43,6 +44,9 @@ void	cmd_find_window_free(struct window_choose_data *);
 	 CMD_FIND_WINDOW_BY_CONTENT |	\
 	 CMD_FIND_WINDOW_BY_NAME)
 
+/* Milliseconds to search for before letting the server run. */
+#define CMD_FIND_WINDOW_STEP 10
+
 const struct cmd_entry cmd_find_window_entry = {
 	"find-window", "findw",
 	"F:CNt:T", 1, 4,
@@ -54,15 +58,49 @@ const struct cmd_entry cmd_find_window_entry = {
 };
 
 struct cmd_find_window_data {
-	struct winlink	*wl;
+	int		 idx;
 	char		*list_ctx;
 	u_int		 pane_id;
 };
 ARRAY_DECL(cmd_find_window_data_list, struct cmd_find_window_data);
 
+/*
+ * A search in progress. Windows are searched for CMD_FIND_WINDOW_STEP at a
+ * time from a timer so a big search does not hold up the server. Once there
+ * is more than one match the choose list is shown, and later matches are
+ * added to it as they are found.
+ */
+struct cmd_find_window_state {
+	struct client			*c;
+	struct session			*s;
+	u_int				 pane;	/* pane to show the list in */
+
+	char				*str;
+	char				*searchstr;
+	struct search			 search;
+	u_int				 match_flags;
+	char				*template;
+
+	int				 next;	/* index of next window */
+	struct cmd_find_window_data_list list;
+	u_int				 shown;
+	struct window_pane		*wp;	/* set while the list is shown */
+
+	struct event			 timer;
+};
+
 u_int	cmd_find_window_match_flags(struct args *);
+char	*cmd_find_window_search(struct window_pane *, struct search *,
+	    char **);
 void	cmd_find_window_match(struct cmd_find_window_data_list *, int,
-	    struct winlink *, const char *, const char *);
+	    struct winlink *, const char *, struct search *);
+int	cmd_find_window_step(struct cmd_find_window_state *);
+u_int	cmd_find_window_add(struct cmd_find_window_state *, int);
+int	cmd_find_window_open(struct cmd_find_window_state *);
+void	cmd_find_window_select(struct cmd_find_window_state *);
+void	cmd_find_window_timer(int, short, void *);
+void	cmd_find_window_cancel(void *);
+void	cmd_find_window_stop(struct cmd_find_window_state *);
 
 u_int
 cmd_find_window_match_flags(struct args *args)
@@ -84,14 +122,36 @@ cmd_find_window_match_flags(struct args *args)
 	return (match_flags);
 }
 
+/*
+ * Search the contents of a pane, both the screen and the history. Plain
+ * strings use the history index if the pane has one.
+ */
+char *
+cmd_find_window_search(struct window_pane *wp, struct search *sr,
+    char **where)
+{
+	struct grid	*gd = wp->base.grid;
+	char		*sres;
+	u_int		 line;
+
+	if ((sres = window_pane_find(wp, sr, &line)) == NULL)
+		return (NULL);
+	if (line >= gd->hsize)
+		xasprintf(where, "line %u", line - gd->hsize + 1);
+	else
+		xasprintf(where, "history line %u", gd->hremoved + line);
+	return (sres);
+}
+
 void
 cmd_find_window_match(struct cmd_find_window_data_list *find_list,
-    int match_flags, struct winlink *wl, const char *str, const char *searchstr)
+    int match_flags, struct winlink *wl, const char *searchstr,
+    struct search *sr)
 {
 	struct cmd_find_window_data	 find_data;
 	struct window_pane		*wp;
-	u_int				 i, line;
-	char				*sres;
+	u_int				 i;
+	char				*sres, *where;
 
 	memset(&find_data, 0, sizeof find_data);
 
@@ -113,96 +173,283 @@ cmd_find_window_match(struct cmd_find_window_data_list *find_list,
 		}
 
 		if (match_flags & CMD_FIND_WINDOW_BY_CONTENT &&
-		    (sres = window_pane_search(wp, str, &line)) != NULL) {
+		    (sres = cmd_find_window_search(wp, sr, &where)) != NULL) {
 			xasprintf(&find_data.list_ctx,
-			    "pane %u line %u: \"%s\"", i - 1, line + 1, sres);
+			    "pane %u %s: \"%s\"", i - 1, where, sres);
+			free(where);
 			free(sres);
 			break;
 		}
 	}
 	if (find_data.list_ctx != NULL) {
-		find_data.wl = wl;
+		find_data.idx = wl->idx;
 		find_data.pane_id = i - 1;
 		ARRAY_ADD(find_list, find_data);
 	}
 }
 
+/*
+ * Search windows until they are all done, which returns 1, or until
+ * CMD_FIND_WINDOW_STEP has passed, which returns 0.
+ */
+int
+cmd_find_window_step(struct cmd_find_window_state *st)
+{
+	struct winlink	 find, *wl;
+	struct timeval	 start, tv;
+
+	if (gettimeofday(&start, NULL) != 0)
+		fatal("gettimeofday failed");
+
+	for (;;) {
+		find.idx = st->next;
+		wl = RB_NFIND(winlinks, &st->s->windows, &find);
+		if (wl == NULL)
+			return (1);
+		cmd_find_window_match(&st->list, st->match_flags, wl,
+		    st->searchstr, &st->search);
+
+		if ((wl = RB_NEXT(winlinks, &st->s->windows, wl)) == NULL)
+			return (1);
+		st->next = wl->idx;
+
+		if (gettimeofday(&tv, NULL) != 0)
+			fatal("gettimeofday failed");
+		timersub(&tv, &start, &tv);
+		if (tv.tv_sec != 0 || tv.tv_usec >= CMD_FIND_WINDOW_STEP * 1000)
+			return (0);
+	}
+}
+
+/*
+ * Add matches not yet in the choose list, skipping any whose window has gone.
+ * Returns the number added.
+ */
+u_int
+cmd_find_window_add(struct cmd_find_window_state *st, int append)
+{
+	struct cmd_find_window_data	*find_data;
+	struct window_choose_data	*cdata;
+	struct cmd_ctx			 ctx;
+	struct winlink			*wm;
+	u_int				 n;
+
+	memset(&ctx, 0, sizeof ctx);
+	ctx.curclient = st->c;
+
+	n = 0;
+	for (; st->shown < ARRAY_LENGTH(&st->list); st->shown++) {
+		find_data = &ARRAY_ITEM(&st->list, st->shown);
+		wm = winlink_find_by_index(&st->s->windows, find_data->idx);
+		if (wm == NULL)
+			continue;
+
+		cdata = window_choose_data_create(&ctx);
+		cdata->session = st->s;
+		cdata->idx = wm->idx;
+		cdata->client->references++;
+		cdata->session->references++;
+		cdata->wl = wm;
+
+		cdata->ft_template = xstrdup(st->template);
+		cdata->pane_id = find_data->pane_id;
+
+		format_add(cdata->ft, "line", "%u", st->shown);
+		format_add(cdata->ft, "window_find_matches", "%s",
+		    find_data->list_ctx);
+		format_session(cdata->ft, st->s);
+		format_winlink(cdata->ft, st->s, wm);
+		format_window_pane(cdata->ft, wm->window->active);
+
+		if (append)
+			window_choose_append(st->wp, cdata);
+		else
+			window_choose_add(st->wp, cdata);
+		n++;
+	}
+	return (n);
+}
+
+/* Show the choose list. */
+int
+cmd_find_window_open(struct cmd_find_window_state *st)
+{
+	struct window_pane	*wp;
+
+	wp = window_pane_find_by_id(st->pane);
+	if (wp == NULL || window_pane_set_mode(wp, &window_choose_mode) != 0)
+		return (-1);
+
+	st->wp = wp;
+	if (cmd_find_window_add(st, 0) == 0) {
+		window_pane_reset_mode(wp);
+		st->wp = NULL;
+		return (-1);
+	}
+	window_choose_ready(wp, 0, cmd_find_window_callback,
+	    cmd_find_window_free);
+	return (0);
+}
+
+/* Go straight to the only match. */
+void
+cmd_find_window_select(struct cmd_find_window_state *st)
+{
+	struct session	*s = st->s;
+
+	if (session_select(s, ARRAY_FIRST(&st->list).idx) == 0)
+		server_redraw_session(s);
+	recalculate_sizes();
+}
+
+/* ARGSUSED */
+void
+cmd_find_window_timer(unused int fd, unused short events, void *data)
+{
+	struct cmd_find_window_state	*st = data;
+	struct timeval			 tv;
+	int				 done;
+
+	if ((st->c->flags & CLIENT_DEAD) || !session_alive(st->s)) {
+		cmd_find_window_stop(st);
+		return;
+	}
+
+	done = cmd_find_window_step(st);
+	if (st->wp != NULL)
+		cmd_find_window_add(st, 1);
+	else if (ARRAY_LENGTH(&st->list) > 1) {
+		if (cmd_find_window_open(st) != 0) {
+			cmd_find_window_stop(st);
+			return;
+		}
+		if (!done)
+			window_choose_background(st->wp, cmd_find_window_cancel,
+			    st);
+	}
+
+	if (!done) {
+		timerclear(&tv);
+		evtimer_add(&st->timer, &tv);
+		return;
+	}
+
+	if (st->wp == NULL) {
+		if (ARRAY_LENGTH(&st->list) == 0) {
+			if (st->c->session != NULL)
+				status_message_set(st->c,
+				    "no windows matching: %s", st->str);
+		} else
+			cmd_find_window_select(st);
+	}
+	cmd_find_window_stop(st);
+}
+
+/* The choose list has gone, so there is no point in carrying on. */
+void
+cmd_find_window_cancel(void *data)
+{
+	struct cmd_find_window_state	*st = data;
+
+	st->wp = NULL;
+	cmd_find_window_stop(st);
+}
+
+void
+cmd_find_window_stop(struct cmd_find_window_state *st)
+{
+	u_int	i;
+
+	if (st->wp != NULL)
+		window_choose_background(st->wp, NULL, NULL);
+	evtimer_del(&st->timer);
+
+	st->c->references--;
+	st->s->references--;
+
+	for (i = 0; i < ARRAY_LENGTH(&st->list); i++)
+		free(ARRAY_ITEM(&st->list, i).list_ctx);
+	ARRAY_FREE(&st->list);
+
+	search_free(&st->search);
+	free(st->searchstr);
+	free(st->str);
+	free(st->template);
+	free(st);
+}
+
 enum cmd_retval
 cmd_find_window_exec(struct cmd *self, struct cmd_ctx *ctx)
 {
 	struct args			*args = self->args;
-	struct window_choose_data	*cdata;
-	struct session			*s;
-	struct winlink			*wl, *wm;
-	struct cmd_find_window_data_list find_list;
-	char				*str, *searchstr;
+	struct cmd_find_window_state	*st;
+	struct winlink			*wl;
+	struct timeval			 tv;
 	const char			*template;
-	u_int				 i, match_flags;
+	char				*str, *cause;
+	int				 flags;
 
 	if (ctx->curclient == NULL) {
 		ctx->error(ctx, "must be run interactively");
 		return (CMD_RETURN_ERROR);
 	}
-	s = ctx->curclient->session;
 
 	if ((wl = cmd_find_window(ctx, args_get(args, 't'), NULL)) == NULL)
 		return (CMD_RETURN_ERROR);
 
 	if ((template = args_get(args, 'F')) == NULL)
 		template = FIND_WINDOW_TEMPLATE;
-
-	match_flags = cmd_find_window_match_flags(args);
 	str = args->argv[0];
 
-	ARRAY_INIT(&find_list);
-
-	xasprintf(&searchstr, "*%s*", str);
-	RB_FOREACH(wm, winlinks, &s->windows)
-	    cmd_find_window_match (&find_list, match_flags, wm, str, searchstr);
-	free(searchstr);
-
-	if (ARRAY_LENGTH(&find_list) == 0) {
-		ctx->error(ctx, "no windows matching: %s", str);
-		ARRAY_FREE(&find_list);
+	st = xcalloc(1, sizeof *st);
+	flags = strpbrk(str, "*?[") == NULL ? 0 : SEARCH_GLOB;
+	if (search_compile(&st->search, str, flags, &cause) != 0) {
+		ctx->error(ctx, "%s", cause);
+		free(cause);
+		free(st);
 		return (CMD_RETURN_ERROR);
 	}
 
-	if (ARRAY_LENGTH(&find_list) == 1) {
-		if (session_select(s, ARRAY_FIRST(&find_list).wl->idx) == 0)
-			server_redraw_session(s);
-		recalculate_sizes();
-		goto out;
+	st->c = ctx->curclient;
+	st->c->references++;
+	st->s = ctx->curclient->session;
+	st->s->references++;
+	st->pane = wl->window->active->id;
+
+	st->str = xstrdup(str);
+	xasprintf(&st->searchstr, "*%s*", str);
+	st->match_flags = cmd_find_window_match_flags(args);
+	st->template = xstrdup(template);
+
+	ARRAY_INIT(&st->list);
+	st->next = RB_MIN(winlinks, &st->s->windows)->idx;
+	evtimer_set(&st->timer, cmd_find_window_timer, st);
+
+	/* If everything is searched quickly, do it all now. */
+	if (cmd_find_window_step(st)) {
+		if (ARRAY_LENGTH(&st->list) == 0) {
+			ctx->error(ctx, "no windows matching: %s", str);
+			cmd_find_window_stop(st);
+			return (CMD_RETURN_ERROR);
+		}
+		if (ARRAY_LENGTH(&st->list) == 1)
+			cmd_find_window_select(st);
+		else
+			cmd_find_window_open(st);
+		cmd_find_window_stop(st);
+		return (CMD_RETURN_NORMAL);
 	}
 
-	if (window_pane_set_mode(wl->window->active, &window_choose_mode) != 0)
-		goto out;
-
-	for (i = 0; i < ARRAY_LENGTH(&find_list); i++) {
-		wm = ARRAY_ITEM(&find_list, i).wl;
-
-		cdata = window_choose_data_create(ctx);
-		cdata->idx = wm->idx;
-		cdata->client->references++;
-		cdata->wl = wm;
-
-		cdata->ft_template = xstrdup(template);
-		cdata->pane_id = ARRAY_ITEM(&find_list, i).pane_id;
-
-		format_add(cdata->ft, "line", "%u", i);
-		format_add(cdata->ft, "window_find_matches", "%s",
-		    ARRAY_ITEM(&find_list, i).list_ctx);
-		format_session(cdata->ft, s);
-		format_winlink(cdata->ft, s, wm);
-		format_window_pane(cdata->ft, wm->window->active);
-
-		window_choose_add(wl->window->active, cdata);
+	if (ARRAY_LENGTH(&st->list) > 1) {
+		if (cmd_find_window_open(st) != 0) {
+			cmd_find_window_stop(st);
+			return (CMD_RETURN_NORMAL);
+		}
+		window_choose_background(st->wp, cmd_find_window_cancel, st);
 	}
+	timerclear(&tv);
+	evtimer_add(&st->timer, &tv);
 
-	window_choose_ready(wl->window->active,
-	    0, cmd_find_window_callback, cmd_find_window_free);
-
-out:
-	ARRAY_FREE(&find_list);
 	return (CMD_RETURN_NORMAL);
 }
 
@@ -235,6 +482,7 @@ cmd_find_window_free(struct window_choose_data *cdata)
 	if (cdata == NULL)
 		return;
 
+	cdata->client->references--;
 	cdata->session->references--;
 
 	free(cdata->ft_template);
@@ -21,6 +21,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
@@ -28,17 +29,20 @@
 #include "tmux.h"
 
 /*
- * Open pipe to redirect pane output. If already open, close first.
+ * Open pipe to redirect pane output. If a pipe with the same name is already
+ * open, close it first.
  */
 
+#define PIPE_PANE_DEFAULT "default"
+
 enum cmd_retval	 cmd_pipe_pane_exec(struct cmd *, struct cmd_ctx *);
 
-void	cmd_pipe_pane_error_callback(struct bufferevent *, short, void *);
+void	cmd_pipe_pane_list(struct cmd_ctx *, struct window_pane *);
 
 const struct cmd_entry cmd_pipe_pane_entry = {
 	"pipe-pane", "pipep",
-	"ot:", 0, 1,
-	"[-o] " CMD_TARGET_PANE_USAGE " [command]",
+	"alon:p:t:", 0, 1,
+	"[-alo] [-n name] [-p policy] " CMD_TARGET_PANE_USAGE " [command]",
 	0,
 	NULL,
 	NULL,
@@ -51,19 +55,46 @@ cmd_pipe_pane_exec(struct cmd *self, struct cmd_ctx *ctx)
 	struct args		*args = self->args;
 	struct client		*c;
 	struct window_pane	*wp;
-	char			*command;
-	int			 old_fd, pipe_fd[2], null_fd;
+	struct pane_pipe	*pp;
+	struct spawn		 sp;
+	const char		*name, *value, **choice;
+	char			*argv[4];
+	pid_t			 pid;
+	int			 old, policy, pipe_fd[2], null_fd;
 
 	if (cmd_find_pane(ctx, args_get(args, 't'), NULL, &wp) == NULL)
 		return (CMD_RETURN_ERROR);
 	c = cmd_find_client(ctx, NULL);
 
-	/* Destroy the old pipe. */
-	old_fd = wp->pipe_fd;
-	if (wp->pipe_fd != -1) {
-		bufferevent_free(wp->pipe_event);
-		close(wp->pipe_fd);
-		wp->pipe_fd = -1;
+	if (args_has(args, 'l')) {
+		cmd_pipe_pane_list(ctx, wp);
+		return (CMD_RETURN_NORMAL);
+	}
+
+	if ((name = args_get(args, 'n')) == NULL || *name == '\0')
+		name = PIPE_PANE_DEFAULT;
+
+	policy = options_get_number(&wp->window->options, "pipe-pane-policy");
+	if ((value = args_get(args, 'p')) != NULL) {
+		choice = options_table_pipe_pane_policy_list;
+		for (policy = 0; choice[policy] != NULL; policy++) {
+			if (strcmp(choice[policy], value) == 0)
+				break;
+		}
+		if (choice[policy] == NULL) {
+			ctx->error(ctx, "unknown policy: %s", value);
+			return (CMD_RETURN_ERROR);
+		}
+	}
+
+	/* Destroy the old pipe, or all of them with -a. */
+	old = 0;
+	if (args_has(args, 'a')) {
+		old = !TAILQ_EMPTY(&wp->pipes);
+		pipe_close_all(wp);
+	} else if ((pp = pipe_find(wp, name)) != NULL) {
+		old = 1;
+		pipe_close(pp);
 	}
 
 	/* If no pipe command, that is enough. */
@@ -76,7 +107,7 @@ cmd_pipe_pane_exec(struct cmd *self, struct cmd_ctx *ctx)
 	 *
 	 *	bind ^p pipep -o 'cat >>~/output'
 	 */
-	if (args_has(self->args, 'o') && old_fd != -1)
+	if (args_has(self->args, 'o') && old)
 		return (CMD_RETURN_NORMAL);
 
 	/* Open the new pipe. */
@@ -85,59 +116,57 @@ cmd_pipe_pane_exec(struct cmd *self, struct cmd_ctx *ctx)
 		return (CMD_RETURN_ERROR);
 	}
 
-	/* Fork the child. */
-	switch (fork()) {
-	case -1:
-		ctx->error(ctx, "fork error: %s", strerror(errno));
-		return (CMD_RETURN_ERROR);
-	case 0:
-		/* Child process. */
+	null_fd = open(_PATH_DEVNULL, O_WRONLY, 0);
+	if (null_fd == -1) {
+		ctx->error(ctx, "open error: %s", strerror(errno));
 		close(pipe_fd[0]);
-		clear_signals(1);
-
-		if (dup2(pipe_fd[1], STDIN_FILENO) == -1)
-			_exit(1);
-		if (pipe_fd[1] != STDIN_FILENO)
-			close(pipe_fd[1]);
-
-		null_fd = open(_PATH_DEVNULL, O_WRONLY, 0);
-		if (dup2(null_fd, STDOUT_FILENO) == -1)
-			_exit(1);
-		if (dup2(null_fd, STDERR_FILENO) == -1)
-			_exit(1);
-		if (null_fd != STDOUT_FILENO && null_fd != STDERR_FILENO)
-			close(null_fd);
-
-		closefrom(STDERR_FILENO + 1);
-
-		command = status_replace(
-		    c, NULL, NULL, NULL, args->argv[0], time(NULL), 0);
-		execl(_PATH_BSHELL, "sh", "-c", command, (char *) NULL);
-		_exit(1);
-	default:
-		/* Parent process. */
 		close(pipe_fd[1]);
+		return (CMD_RETURN_ERROR);
+	}
 
-		wp->pipe_fd = pipe_fd[0];
-		wp->pipe_off = EVBUFFER_LENGTH(wp->event->input);
+	argv[0] = xstrdup("sh");
+	argv[1] = xstrdup("-c");
+	argv[2] = status_replace(
+	    c, NULL, NULL, NULL, args->argv[0], time(NULL), 0);
+	argv[3] = NULL;
+
+	memset(&sp, 0, sizeof sp);
+	sp.path = _PATH_BSHELL;
+	sp.argv = argv;
+	sp.envp = environ;
+	sp.fds[0] = pipe_fd[1];
+	sp.fds[1] = null_fd;
+	sp.fds[2] = null_fd;
+
+	/* Start the child. */
+	pid = spawn_process(&sp);
+	if (pid == -1)
+		ctx->error(ctx, "fork error: %s", strerror(errno));
 
-		wp->pipe_event = bufferevent_new(wp->pipe_fd,
-		    NULL, NULL, cmd_pipe_pane_error_callback, wp);
-		bufferevent_enable(wp->pipe_event, EV_WRITE);
+	free(argv[0]);
+	free(argv[1]);
+	free(argv[2]);
+	close(null_fd);
+	close(pipe_fd[1]);
 
-		setblocking(wp->pipe_fd, 0);
-		return (CMD_RETURN_NORMAL);
+	if (pid == -1) {
+		close(pipe_fd[0]);
+		return (CMD_RETURN_ERROR);
 	}
+
+	pipe_open(wp, name, args->argv[0], pipe_fd[0], policy);
+	return (CMD_RETURN_NORMAL);
 }
 
-/* ARGSUSED */
 void
-cmd_pipe_pane_error_callback(
-    unused struct bufferevent *bufev, unused short what, void *data)
+cmd_pipe_pane_list(struct cmd_ctx *ctx, struct window_pane *wp)
 {
-	struct window_pane	*wp = data;
+	struct pane_pipe	*pp;
 
-	bufferevent_free(wp->pipe_event);
-	close(wp->pipe_fd);
-	wp->pipe_fd = -1;
+	TAILQ_FOREACH(pp, &wp->pipes, entry) {
+		ctx->print(ctx, "%s: %s, %zu bytes waiting, %llu dropped "
+		    "(%s)%s", pp->name, pp->cmd, pp->waiting, pp->dropped,
+		    options_table_pipe_pane_policy_list[pp->policy],
+		    (pp->flags & PIPE_PAUSED) ? " [paused]" : "");
+	}
 }
@@ -0,0 +1,87 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Nicholas Marriott <nicm@users.sourceforge.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/types.h>
+
+#include <stdlib.h>
+
+#include "tmux.h"
+
+/*
+ * Record pane output to a file. If already recording, stop first.
+ */
+
+enum cmd_retval	 cmd_record_pane_exec(struct cmd *, struct cmd_ctx *);
+
+const struct cmd_entry cmd_record_pane_entry = {
+	"record-pane", "recordp",
+	"ot:", 0, 1,
+	"[-o] " CMD_TARGET_PANE_USAGE " [path]",
+	0,
+	NULL,
+	NULL,
+	cmd_record_pane_exec
+};
+
+enum cmd_retval
+cmd_record_pane_exec(struct cmd *self, struct cmd_ctx *ctx)
+{
+	struct args		*args = self->args;
+	struct client		*c = ctx->cmdclient;
+	struct session		*s;
+	struct window_pane	*wp;
+	const char		*path, *newpath, *wd;
+	char			*cause;
+	int			 old;
+
+	if (cmd_find_pane(ctx, args_get(args, 't'), &s, &wp) == NULL)
+		return (CMD_RETURN_ERROR);
+
+	/* Stop any existing recording. */
+	old = (wp->record != NULL);
+	record_stop(wp);
+
+	/* If no path, that is enough. */
+	if (args->argc == 0 || *args->argv[0] == '\0')
+		return (CMD_RETURN_NORMAL);
+
+	/* With -o, only start recording if there was no previous one. */
+	if (args_has(self->args, 'o') && old)
+		return (CMD_RETURN_NORMAL);
+
+	path = args->argv[0];
+	if (c != NULL)
+		wd = c->cwd;
+	else {
+		wd = options_get_string(&s->options, "default-path");
+		if (*wd == '\0')
+			wd = s->cwd;
+	}
+	if (wd != NULL && *wd != '\0') {
+		newpath = get_full_path(wd, path);
+		if (newpath != NULL)
+			path = newpath;
+	}
+
+	if (record_start(wp, path, &cause) != 0) {
+		ctx->error(ctx, "%s", cause);
+		free(cause);
+		return (CMD_RETURN_ERROR);
+	}
+	return (CMD_RETURN_NORMAL);
+}
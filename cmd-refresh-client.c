@@ -18,6 +18,9 @@
 
 #include <sys/types.h>
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "tmux.h"
 
 /*
@@ -26,10 +29,13 @@
 
 enum cmd_retval	 cmd_refresh_client_exec(struct cmd *, struct cmd_ctx *);
 
+enum cmd_retval	 cmd_refresh_client_pane(struct cmd_ctx *, struct client *,
+		     const char *);
+
 const struct cmd_entry cmd_refresh_client_entry = {
 	"refresh-client", "refresh",
-	"St:", 0, 0,
-	"[-S] " CMD_TARGET_CLIENT_USAGE,
+	"A:F:St:", 0, 0,
+	"[-S] [-A pane:state] [-F flags] " CMD_TARGET_CLIENT_USAGE,
 	0,
 	NULL,
 	NULL,
@@ -41,15 +47,74 @@ cmd_refresh_client_exec(struct cmd *self, struct cmd_ctx *ctx)
 {
 	struct args	*args = self->args;
 	struct client	*c;
+	char		*cause;
 
 	if ((c = cmd_find_client(ctx, args_get(args, 't'))) == NULL)
 		return (CMD_RETURN_ERROR);
 
+	if (args_has(args, 'A') || args_has(args, 'F')) {
+		if (!(c->flags & CLIENT_CONTROL)) {
+			ctx->error(ctx, "not a control client");
+			return (CMD_RETURN_ERROR);
+		}
+	}
+	if (args_has(args, 'A'))
+		return (cmd_refresh_client_pane(ctx, c, args_get(args, 'A')));
+	if (args_has(args, 'F')) {
+		if (control_set_flags(c, args_get(args, 'F'), &cause) != 0) {
+			ctx->error(ctx, "%s", cause);
+			free(cause);
+			return (CMD_RETURN_ERROR);
+		}
+		return (CMD_RETURN_NORMAL);
+	}
+
 	if (args_has(args, 'S')) {
-		status_update_jobs(c);
+		if (c->session != NULL)
+			status_invalidate_session(c->session, 0);
+		status_update_jobs();
 		server_status_client(c);
 	} else
 		server_redraw_client(c);
 
 	return (CMD_RETURN_NORMAL);
 }
+
+/* Change the state of a pane for a control client. */
+enum cmd_retval
+cmd_refresh_client_pane(struct cmd_ctx *ctx, struct client *c,
+    const char *arg)
+{
+	struct window_pane	*wp;
+	char			*copy, *state;
+
+	copy = xstrdup(arg);
+	if ((state = strrchr(copy, ':')) == NULL) {
+		ctx->error(ctx, "bad pane state: %s", arg);
+		free(copy);
+		return (CMD_RETURN_ERROR);
+	}
+	*state++ = '\0';
+
+	if (cmd_find_pane(ctx, copy, NULL, &wp) == NULL) {
+		free(copy);
+		return (CMD_RETURN_ERROR);
+	}
+
+	if (strcmp(state, "on") == 0)
+		control_set_pane(c, wp, 1);
+	else if (strcmp(state, "off") == 0)
+		control_set_pane(c, wp, 0);
+	else if (strcmp(state, "continue") == 0)
+		control_continue_pane(c, wp);
+	else if (strcmp(state, "pause") == 0)
+		control_pause_pane(c, wp);
+	else {
+		ctx->error(ctx, "unknown state: %s", state);
+		free(copy);
+		return (CMD_RETURN_ERROR);
+	}
+
+	free(copy);
+	return (CMD_RETURN_NORMAL);
+}
@@ -63,6 +63,7 @@ cmd_rename_session_exec(struct cmd *self, struct cmd_ctx *ctx)
 	s->name = xstrdup(newname);
 	RB_INSERT(sessions, &sessions, s);
 
+	status_invalidate_session(s, 0);
 	server_status_session(s);
 	notify_session_renamed(s);
 
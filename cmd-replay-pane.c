@@ -0,0 +1,123 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Nicholas Marriott <nicm@users.sourceforge.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tmux.h"
+
+/*
+ * Replay a recording made by record-pane into a pane.
+ */
+
+enum cmd_retval	 cmd_replay_pane_exec(struct cmd *, struct cmd_ctx *);
+
+const struct cmd_entry cmd_replay_pane_entry = {
+	"replay-pane", "replayp",
+	"ft:", 0, 1,
+	"[-f] " CMD_TARGET_PANE_USAGE " [path]",
+	0,
+	NULL,
+	NULL,
+	cmd_replay_pane_exec
+};
+
+enum cmd_retval
+cmd_replay_pane_exec(struct cmd *self, struct cmd_ctx *ctx)
+{
+	struct args		*args = self->args;
+	struct client		*c = ctx->cmdclient;
+	struct session		*s;
+	struct window_pane	*wp;
+	struct stat		 sb;
+	const char		*path, *newpath, *wd;
+	char			*cause;
+	u_char			*buf;
+	ssize_t			 n;
+	size_t			 len;
+	int			 fd, flags;
+
+	if (cmd_find_pane(ctx, args_get(args, 't'), &s, &wp) == NULL)
+		return (CMD_RETURN_ERROR);
+
+	/* With no path, stop any replay. */
+	if (args->argc == 0 || *args->argv[0] == '\0') {
+		replay_stop(wp);
+		return (CMD_RETURN_NORMAL);
+	}
+
+	path = args->argv[0];
+	if (c != NULL)
+		wd = c->cwd;
+	else {
+		wd = options_get_string(&s->options, "default-path");
+		if (*wd == '\0')
+			wd = s->cwd;
+	}
+	if (wd != NULL && *wd != '\0') {
+		newpath = get_full_path(wd, path);
+		if (newpath != NULL)
+			path = newpath;
+	}
+
+	if ((fd = open(path, O_RDONLY)) == -1 || fstat(fd, &sb) != 0) {
+		ctx->error(ctx, "%s: %s", path, strerror(errno));
+		if (fd != -1)
+			close(fd);
+		return (CMD_RETURN_ERROR);
+	}
+
+	/* Do not let the server die due to memory exhaustion. */
+	if ((buf = malloc(sb.st_size + 1)) == NULL) {
+		ctx->error(ctx, "malloc error: %s", strerror(errno));
+		close(fd);
+		return (CMD_RETURN_ERROR);
+	}
+	len = 0;
+	while (len < (size_t) sb.st_size) {
+		n = read(fd, buf + len, sb.st_size - len);
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		len += n;
+	}
+	close(fd);
+	if (len != (size_t) sb.st_size) {
+		ctx->error(ctx, "%s: read error", path);
+		free(buf);
+		return (CMD_RETURN_ERROR);
+	}
+
+	flags = 0;
+	if (args_has(args, 'f'))
+		flags |= REPLAY_FAST;
+	if (replay_start(wp, buf, len, flags, &cause) != 0) {
+		ctx->error(ctx, "%s: %s", path, cause);
+		free(cause);
+		free(buf);
+		return (CMD_RETURN_ERROR);
+	}
+	return (CMD_RETURN_NORMAL);
+}
@@ -81,6 +81,7 @@ cmd_rotate_window_exec(struct cmd *self, struct cmd_ctx *ctx)
 			wp->layout_cell->wp = wp;
 		wp->xoff = xoff; wp->yoff = yoff;
 		window_pane_resize(wp, sx, sy);
+		screen_redraw_invalidate(w);
 
 		if ((wp = TAILQ_PREV(w->active, window_panes, entry)) == NULL)
 			wp = TAILQ_LAST(&w->panes, window_panes);
@@ -108,6 +109,7 @@ cmd_rotate_window_exec(struct cmd *self, struct cmd_ctx *ctx)
 			wp->layout_cell->wp = wp;
 		wp->xoff = xoff; wp->yoff = yoff;
 		window_pane_resize(wp, sx, sy);
+		screen_redraw_invalidate(w);
 
 		if ((wp = TAILQ_NEXT(w->active, entry)) == NULL)
 			wp = TAILQ_FIRST(&w->panes);
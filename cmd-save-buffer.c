@@ -22,6 +22,7 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "tmux.h"
 
@@ -29,8 +30,28 @@
  * Saves a paste buffer to a file.
  */
 
+/* Most to write to stdout at once. */
+#define SAVE_BUFFER_WRITE 65536
+
 enum cmd_retval	 cmd_save_buffer_exec(struct cmd *, struct cmd_ctx *);
 
+/*
+ * Writing to stdout goes through a pipe to the client a piece at a time. The
+ * buffer may be replaced or deleted in between, so it is written from a copy
+ * taken at the start.
+ */
+struct cmd_save_buffer_data {
+	struct cmd_ctx		 ctx;
+	char			*data;
+	size_t			 size;
+	size_t			 off;
+	int			 fd;
+	struct event		 event;
+};
+
+void	cmd_save_buffer_callback(int, short, void *);
+void	cmd_save_buffer_free(struct cmd_save_buffer_data *);
+
 const struct cmd_entry cmd_save_buffer_entry = {
 	"save-buffer", "saveb",
 	"ab:", 1, 1,
@@ -44,15 +65,16 @@ const struct cmd_entry cmd_save_buffer_entry = {
 enum cmd_retval
 cmd_save_buffer_exec(struct cmd *self, struct cmd_ctx *ctx)
 {
-	struct args		*args = self->args;
-	struct client		*c = ctx->cmdclient;
-	struct session          *s;
-	struct paste_buffer	*pb;
-	const char		*path, *newpath, *wd;
-	char			*cause;
-	int			 buffer;
-	mode_t			 mask;
-	FILE			*f;
+	struct args			*args = self->args;
+	struct client			*c = ctx->cmdclient;
+	struct session			*s;
+	struct paste_buffer		*pb;
+	struct cmd_save_buffer_data	*cdata;
+	const char			*path, *newpath, *wd;
+	char				*cause;
+	int				 buffer, fd;
+	mode_t				 mask;
+	FILE				*f;
 
 	if (!args_has(args, 'b')) {
 		if ((pb = paste_get_top(&global_buffers)) == NULL) {
@@ -80,8 +102,24 @@ cmd_save_buffer_exec(struct cmd *self, struct cmd_ctx *ctx)
 			ctx->error(ctx, "%s: can't write to stdout", path);
 			return (CMD_RETURN_ERROR);
 		}
-		evbuffer_add(c->stdout_data, pb->data, pb->size);
-		server_push_stdout(c);
+		if ((fd = server_stdout_pipe(c)) == -1) {
+			ctx->error(ctx, "%s: %s", path, strerror(errno));
+			return (CMD_RETURN_ERROR);
+		}
+
+		cdata = xmalloc(sizeof *cdata);
+		memcpy(&cdata->ctx, ctx, sizeof cdata->ctx);
+		cdata->data = xmalloc(pb->size == 0 ? 1 : pb->size);
+		memcpy(cdata->data, pb->data, pb->size);
+		cdata->size = pb->size;
+		cdata->off = 0;
+		cdata->fd = fd;
+		c->references++;
+
+		event_set(&cdata->event, fd, EV_WRITE|EV_PERSIST,
+		    cmd_save_buffer_callback, cdata);
+		event_add(&cdata->event, NULL);
+		return (CMD_RETURN_YIELD);
 	} else {
 		if (c != NULL)
 			wd = c->cwd;
@@ -117,3 +155,50 @@ cmd_save_buffer_exec(struct cmd *self, struct cmd_ctx *ctx)
 
 	return (CMD_RETURN_NORMAL);
 }
+
+/* Write the next piece of the buffer. */
+/* ARGSUSED */
+void
+cmd_save_buffer_callback(unused int fd, unused short events, void *data)
+{
+	struct cmd_save_buffer_data	*cdata = data;
+	struct cmd_ctx			*ctx = &cdata->ctx;
+	size_t				 size;
+	ssize_t				 n;
+
+	if (ctx->cmdclient->flags & CLIENT_DEAD) {
+		cmd_save_buffer_free(cdata);
+		return;
+	}
+
+	if (cdata->off < cdata->size) {
+		size = cdata->size - cdata->off;
+		if (size > SAVE_BUFFER_WRITE)
+			size = SAVE_BUFFER_WRITE;
+
+		n = write(cdata->fd, cdata->data + cdata->off, size);
+		if (n == -1) {
+			if (errno == EINTR || errno == EAGAIN)
+				return;
+			ctx->error(ctx, "-: %s", strerror(errno));
+			goto done;
+		}
+		cdata->off += n;
+		if (cdata->off < cdata->size)
+			return;
+	}
+
+done:
+	ctx->cmdclient->flags |= CLIENT_EXIT;
+	cmd_save_buffer_free(cdata);
+}
+
+void
+cmd_save_buffer_free(struct cmd_save_buffer_data *cdata)
+{
+	event_del(&cdata->event);
+	close(cdata->fd);
+	cdata->ctx.cmdclient->references--;
+	free(cdata->data);
+	free(cdata);
+}
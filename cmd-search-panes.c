@@ -0,0 +1,143 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Nicholas Marriott <nicm@users.sourceforge.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/types.h>
+
+#include <stdlib.h>
+
+#include "tmux.h"
+
+/*
+ * Search the history and contents of every pane on the server.
+ */
+
+enum cmd_retval	 cmd_search_panes_exec(struct cmd *, struct cmd_ctx *);
+
+int	cmd_search_panes_match(struct search_text *, size_t, size_t, void *);
+
+const struct cmd_entry cmd_search_panes_entry = {
+	"search-panes", "searchp",
+	"F:r", 1, 1,
+	"[-r] [-F format] match-string",
+	CMD_READONLY,
+	NULL,
+	NULL,
+	cmd_search_panes_exec
+};
+
+struct cmd_search_panes_data {
+	struct cmd_ctx		*ctx;
+	const char		*template;
+
+	struct session		*s;
+	struct winlink		*wl;
+	struct window_pane	*wp;
+	struct format_tree	*ft;
+
+	u_int			 matches;
+};
+
+/* Print a matching line. */
+/* ARGSUSED */
+int
+cmd_search_panes_match(struct search_text *st, size_t off, unused size_t size,
+    void *data)
+{
+	struct cmd_search_panes_data	*sd = data;
+	struct grid			*gd = sd->wp->base.grid;
+	char				*line;
+
+	/* The pane formats are the same for every match so add them once. */
+	if (sd->ft == NULL) {
+		sd->ft = format_create();
+		format_session(sd->ft, sd->s);
+		format_winlink(sd->ft, sd->s, sd->wl);
+		format_window_pane(sd->ft, sd->wp);
+	}
+	format_add(sd->ft, "search_line", "%u", gd->hremoved + st->py[off]);
+	format_add(sd->ft, "search_match", "%s", st->buf);
+
+	line = format_expand(sd->ft, sd->template);
+	sd->ctx->print(sd->ctx, "%s", line);
+	free(line);
+
+	sd->matches++;
+	return (1);
+}
+
+enum cmd_retval
+cmd_search_panes_exec(struct cmd *self, struct cmd_ctx *ctx)
+{
+	struct args			*args = self->args;
+	struct cmd_search_panes_data	 sd;
+	struct search			 search;
+	struct session			*s;
+	struct winlink			*wl;
+	struct window_pane		*wp;
+	ARRAY_DECL(, struct window *)	 done;
+	char				*cause;
+	u_int				 i;
+	int				 flags;
+
+	flags = 0;
+	if (args_has(args, 'r'))
+		flags |= SEARCH_REGEX;
+	if (search_compile(&search, args->argv[0], flags, &cause) != 0) {
+		ctx->error(ctx, "%s", cause);
+		free(cause);
+		return (CMD_RETURN_ERROR);
+	}
+
+	sd.ctx = ctx;
+	if ((sd.template = args_get(args, 'F')) == NULL)
+		sd.template = SEARCH_PANES_TEMPLATE;
+	sd.matches = 0;
+
+	/* Linked windows are searched only the first time they are seen. */
+	ARRAY_INIT(&done);
+	RB_FOREACH(s, sessions, &sessions) {
+		RB_FOREACH(wl, winlinks, &s->windows) {
+			for (i = 0; i < ARRAY_LENGTH(&done); i++) {
+				if (ARRAY_ITEM(&done, i) == wl->window)
+					break;
+			}
+			if (i != ARRAY_LENGTH(&done))
+				continue;
+			ARRAY_ADD(&done, wl->window);
+
+			sd.s = s;
+			sd.wl = wl;
+			TAILQ_FOREACH(wp, &wl->window->panes, entry) {
+				sd.wp = wp;
+				sd.ft = NULL;
+				search_grid(&search, wp->base.grid,
+				    cmd_search_panes_match, &sd);
+				if (sd.ft != NULL)
+					format_free(sd.ft);
+			}
+		}
+	}
+	ARRAY_FREE(&done);
+	search_free(&search);
+
+	if (sd.matches == 0) {
+		ctx->error(ctx, "no panes matching: %s", args->argv[0]);
+		return (CMD_RETURN_ERROR);
+	}
+	return (CMD_RETURN_NORMAL);
+}
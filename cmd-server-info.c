@@ -56,6 +56,7 @@ cmd_server_info_exec(unused struct cmd *self, struct cmd_ctx *ctx)
 	const struct tty_term_code_entry	*ent;
 	struct utsname				 un;
 	struct job				*job;
+	struct status_out			*so;
 	struct grid				*gd;
 	struct grid_line			*gl;
 	u_int		 			 i, j, k;
@@ -178,6 +179,14 @@ cmd_server_info_exec(unused struct cmd *self, struct cmd_ctx *ctx)
 		ctx->print(ctx, "%s [fd=%d, pid=%d, status=%d]",
 		    job->cmd, job->fd, job->pid, job->status);
 	}
+	ctx->print(ctx, "%s", "");
+
+	ctx->print(ctx, "Status jobs:");
+	RB_FOREACH(so, status_out_tree, &status_jobs) {
+		ctx->print(ctx, "%s [runs=%u, failures=%u, latency=%ums%s]",
+		    so->cmd, so->runs, so->failures, so->latency,
+		    so->job != NULL ? ", running" : "");
+	}
 
 	return (CMD_RETURN_NORMAL);
 }
@@ -88,6 +88,7 @@ cmd_set_option_exec(struct cmd *self, struct cmd_ctx *ctx)
 	struct client				*c;
 	struct options				*oo;
 	struct window				*w;
+	struct window_pane			*wp;
 	const char				*optstr, *valstr;
 	u_int					 i;
 
@@ -160,7 +161,26 @@ cmd_set_option_exec(struct cmd *self, struct cmd_ctx *ctx)
 		}
 	}
 
+	/* Recompile the patterns when monitor-content changed. */
+	if (strcmp (oe->name, "monitor-content") == 0) {
+		for (i = 0; i < ARRAY_LENGTH(&windows); i++) {
+			if ((w = ARRAY_ITEM(&windows, i)) != NULL)
+				window_update_content(w);
+		}
+	}
+
+	/* Start, stop or resize history indexes when search-index changed. */
+	if (strcmp (oe->name, "search-index") == 0) {
+		for (i = 0; i < ARRAY_LENGTH(&windows); i++) {
+			if ((w = ARRAY_ITEM(&windows, i)) == NULL)
+				continue;
+			TAILQ_FOREACH(wp, &w->panes, entry)
+				window_pane_update_index(wp);
+		}
+	}
+
 	/* Update sizes and redraw. May not need it but meh. */
+	status_invalidate_all();
 	recalculate_sizes();
 	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
 		c = ARRAY_ITEM(&clients, i);
@@ -242,12 +262,12 @@ cmd_set_option_set(struct cmd *self, struct cmd_ctx *ctx,
 
 /* Set a string option. */
 struct options_entry *
-cmd_set_option_string(struct cmd *self, unused struct cmd_ctx *ctx,
+cmd_set_option_string(struct cmd *self, struct cmd_ctx *ctx,
     const struct options_table_entry *oe, struct options *oo, const char *value)
 {
 	struct args		*args = self->args;
 	struct options_entry	*o;
-	char			*oldval, *newval;
+	char			*oldval, *newval, *cause;
 
 	if (args_has(args, 'a')) {
 		oldval = options_get_string(oo, oe->name);
@@ -255,6 +275,14 @@ cmd_set_option_string(struct cmd *self, unused struct cmd_ctx *ctx,
 	} else
 		newval = xstrdup(value);
 
+	if (strcmp(oe->name, "monitor-content") == 0 &&
+	    content_check(newval, &cause) != 0) {
+		ctx->error(ctx, "%s", cause);
+		free(cause);
+		free(newval);
+		return (NULL);
+	}
+
 	o = options_set_string(oo, oe->name, "%s", newval);
 
 	free(newval);
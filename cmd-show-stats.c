@@ -0,0 +1,103 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Nicholas Marriott <nicm@users.sourceforge.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/types.h>
+
+#include "tmux.h"
+
+/*
+ * Show server statistics.
+ */
+
+enum cmd_retval	 cmd_show_stats_exec(struct cmd *, struct cmd_ctx *);
+
+void	cmd_show_stats_server(struct cmd_ctx *);
+void	cmd_show_stats_client(struct cmd_ctx *, struct client *);
+
+const struct cmd_entry cmd_show_stats_entry = {
+	"show-stats", "showstats",
+	"t:", 0, 0,
+	CMD_TARGET_CLIENT_USAGE,
+	CMD_READONLY,
+	NULL,
+	NULL,
+	cmd_show_stats_exec
+};
+
+void
+cmd_show_stats_server(struct cmd_ctx *ctx)
+{
+	struct stats	*st = &global_stats;
+	u_int		 i;
+
+	ctx->print(ctx, "%llu loops, %llu format expands, %llu job forks",
+	    st->loops, st->format_expands, st->job_forks);
+	ctx->print(ctx, "panes: %llu bytes read, %llu bytes parsed, %llu cells",
+	    st->pane_bytes, st->input_bytes, st->input_cells);
+	ctx->print(ctx, "clients: %llu bytes written, %llu redraws",
+	    st->tty_bytes, st->redraws);
+	for (i = 0; i < STATS_TYPES; i++) {
+		ctx->print(ctx, "%s: %llu calls, %llu.%03llums",
+		    stats_type_names[i], st->calls[i], st->time[i] / 1000,
+		    st->time[i] % 1000);
+	}
+}
+
+void
+cmd_show_stats_client(struct cmd_ctx *ctx, struct client *c)
+{
+	struct latency	*lat = &c->key_latency;
+	const char	*name;
+	u_int		 p50, p99;
+
+	/* Control clients have no tty. */
+	if ((name = c->tty.path) == NULL)
+		name = "control";
+
+	p50 = latency_percentile(lat, 50);
+	p99 = latency_percentile(lat, 99);
+	ctx->print(ctx, "%s: %llu bytes written, %u redraws, %u keys, "
+	    "latency p50 %u.%03ums, p99 %u.%03ums, max %u.%03ums", name,
+	    c->tty.bytes, c->tty.redraws, lat->count, p50 / 1000, p50 % 1000,
+	    p99 / 1000, p99 % 1000, lat->maximum / 1000, lat->maximum % 1000);
+}
+
+enum cmd_retval
+cmd_show_stats_exec(struct cmd *self, struct cmd_ctx *ctx)
+{
+	struct args	*args = self->args;
+	struct client	*c;
+	u_int		 i;
+
+	if (args_has(args, 't')) {
+		if ((c = cmd_find_client(ctx, args_get(args, 't'))) == NULL)
+			return (CMD_RETURN_ERROR);
+		cmd_show_stats_client(ctx, c);
+		return (CMD_RETURN_NORMAL);
+	}
+
+	cmd_show_stats_server(ctx);
+	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
+		c = ARRAY_ITEM(&clients, i);
+		if (c == NULL || c->session == NULL)
+			continue;
+		cmd_show_stats_client(ctx, c);
+	}
+
+	return (CMD_RETURN_NORMAL);
+}
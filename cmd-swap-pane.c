@@ -112,6 +112,8 @@ cmd_swap_pane_exec(struct cmd *self, struct cmd_ctx *ctx)
 	window_pane_resize(src_wp, dst_wp->sx, dst_wp->sy);
 	dst_wp->xoff = xoff; dst_wp->yoff = yoff;
 	window_pane_resize(dst_wp, sx, sy);
+	screen_redraw_invalidate(src_w);
+	screen_redraw_invalidate(dst_w);
 
 	if (!args_has(self->args, 'd')) {
 		if (src_w != dst_w) {
@@ -0,0 +1,303 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Nicholas Marriott <nicm@users.sourceforge.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/types.h>
+
+#include <regex.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tmux.h"
+
+/*
+ * Matching monitor-content patterns as output is written to a pane, rather
+ * than searching the screen afterwards.
+ *
+ * The option is a list of fnmatch(3) patterns separated by |, each matched
+ * anywhere in a line. Patterns which are plain strings (once any leading or
+ * trailing * are removed) are built into one Aho-Corasick automaton, which is
+ * fed each character as it is written, so a string is found once, when its
+ * last character appears. The rest are joined into one regular expression
+ * which is tried against each line as it is finished with a newline.
+ *
+ * The automaton is kept as a full transition table (256 entries per state),
+ * so each byte costs one lookup. The matching state belongs to the pane and
+ * is reset whenever the cursor moves other than by writing, so only text
+ * written in order along a line (or wrapping onto the next) can match.
+ */
+
+struct content {
+	u_int		*next;		/* states * 256 transitions */
+	u_char		*match;		/* a pattern ends at this state */
+	u_int		 states;
+
+	int		 regex_used;
+	regex_t		 regex;
+};
+
+void	content_add(struct content *, const char *, size_t);
+void	content_build(struct content *);
+char   *content_split(struct content *, const char *);
+void	content_feed(struct window_pane *, const u_char *, size_t);
+
+/* Text of the finished line, kept between lines so it is not reallocated. */
+struct search_text	content_text = { .flags = SEARCH_TEXT_ONLY };
+
+/* Add a string to the trie. */
+void
+content_add(struct content *ct, const char *s, size_t len)
+{
+	u_int	state, *next;
+	size_t	i;
+
+	state = 0;
+	for (i = 0; i < len; i++) {
+		next = &ct->next[state * 256 + (u_char) s[i]];
+		if (*next == 0)
+			*next = ct->states++;
+		state = *next;
+	}
+	ct->match[state] = 1;
+}
+
+/*
+ * Fill in the failure transitions, breadth first so a state's failure state
+ * is always done before it. Until a state is reached, 0 in its table means
+ * there is no edge, since nothing goes back to the root in the trie.
+ */
+void
+content_build(struct content *ct)
+{
+	u_int	*queue, *fail, state, child, c;
+	u_int	 head, tail;
+
+	queue = xcalloc(ct->states, sizeof *queue);
+	fail = xcalloc(ct->states, sizeof *fail);
+
+	head = tail = 0;
+	for (c = 0; c < 256; c++) {
+		if ((child = ct->next[c]) != 0)
+			queue[tail++] = child;
+	}
+	while (head != tail) {
+		state = queue[head++];
+		if (ct->match[fail[state]])
+			ct->match[state] = 1;
+		for (c = 0; c < 256; c++) {
+			child = ct->next[state * 256 + c];
+			if (child == 0) {
+				ct->next[state * 256 + c] =
+				    ct->next[fail[state] * 256 + c];
+				continue;
+			}
+			fail[child] = ct->next[fail[state] * 256 + c];
+			queue[tail++] = child;
+		}
+	}
+
+	free(fail);
+	free(queue);
+}
+
+/*
+ * Split a list of patterns, adding the plain strings to the trie (if there is
+ * one) and returning the rest joined into one regular expression, or NULL if
+ * there are none.
+ */
+char *
+content_split(struct content *ct, const char *patterns)
+{
+	const char	*start, *end, *cp;
+	char		*pattern, *re, *all, *tmp;
+	size_t		 len;
+
+	all = NULL;
+	for (start = patterns; start != NULL; start = end) {
+		if ((end = strchr(start, '|')) != NULL)
+			len = end++ - start;
+		else
+			len = strlen(start);
+		if (len == 0)
+			continue;
+		xasprintf(&pattern, "%.*s", (int) len, start);
+
+		/* Strings which can go in the automaton. */
+		cp = pattern;
+		while (*cp == '*')
+			cp++;
+		len = strlen(cp);
+		while (len != 0 && cp[len - 1] == '*')
+			len--;
+		if (len != 0 && strcspn(cp, "*?[\\") >= len) {
+			if (ct != NULL)
+				content_add(ct, cp, len);
+			free(pattern);
+			continue;
+		}
+
+		re = search_glob(pattern);
+		if (all == NULL)
+			xasprintf(&all, "(%s)", re);
+		else {
+			xasprintf(&tmp, "%s|(%s)", all, re);
+			free(all);
+			all = tmp;
+		}
+		free(re);
+		free(pattern);
+	}
+	return (all);
+}
+
+/* Check a list of patterns will compile. */
+int
+content_check(const char *patterns, char **cause)
+{
+	regex_t	 regex;
+	char	*all, error[BUFSIZ];
+	int	 errcode;
+
+	if ((all = content_split(NULL, patterns)) == NULL)
+		return (0);
+	errcode = regcomp(&regex, all, REG_EXTENDED|REG_NOSUB);
+	free(all);
+	if (errcode != 0) {
+		regerror(errcode, &regex, error, sizeof error);
+		xasprintf(cause, "bad pattern: %s", error);
+		return (-1);
+	}
+	regfree(&regex);
+	return (0);
+}
+
+/* Compile a list of patterns. Returns NULL if there are none. */
+struct content *
+content_create(const char *patterns)
+{
+	struct content	*ct;
+	char		*all;
+	size_t		 len;
+
+	if (*patterns == '\0')
+		return (NULL);
+
+	ct = xcalloc(1, sizeof *ct);
+	len = strlen(patterns) + 1;
+	ct->next = xcalloc(len * 256, sizeof *ct->next);
+	ct->match = xcalloc(len, 1);
+	ct->states = 1;
+
+	if ((all = content_split(ct, patterns)) != NULL) {
+		if (regcomp(&ct->regex, all, REG_EXTENDED|REG_NOSUB) == 0)
+			ct->regex_used = 1;
+		else
+			log_debug("bad monitor-content pattern: %s", all);
+		free(all);
+	}
+
+	if (ct->states == 1 && !ct->regex_used) {
+		content_free(ct);
+		return (NULL);
+	}
+	content_build(ct);
+	return (ct);
+}
+
+void
+content_free(struct content *ct)
+{
+	if (ct == NULL)
+		return;
+	if (ct->regex_used)
+		regfree(&ct->regex);
+	free(ct->next);
+	free(ct->match);
+	free(ct);
+}
+
+/* Run bytes through the automaton. */
+void
+content_feed(struct window_pane *wp, const u_char *buf, size_t len)
+{
+	struct content	*ct = wp->window->content;
+	u_int		 state = wp->content_state;
+	size_t		 i;
+
+	for (i = 0; i < len; i++) {
+		state = ct->next[state * 256 + buf[i]];
+		if (ct->match[state])
+			wp->window->flags |= WINDOW_CONTENT;
+	}
+	wp->content_state = state;
+}
+
+/* A cell has been written to the pane at px,py. */
+void
+content_cell(struct window_pane *wp, u_int px, u_int py,
+    const struct grid_cell *gc, const struct utf8_data *utf8data)
+{
+	if (wp->window->content == NULL || wp->window->content->states == 1)
+		return;
+
+	if (px != wp->content_cx || py != wp->content_cy)
+		wp->content_state = 0;
+	if (gc->flags & GRID_FLAG_UTF8) {
+		content_feed(wp, utf8data->data, utf8data->size);
+		wp->content_cx = px + utf8data->width;
+	} else {
+		content_feed(wp, &gc->data, 1);
+		wp->content_cx = px + 1;
+	}
+	wp->content_cy = py;
+}
+
+/*
+ * There is about to be a linefeed in the pane. If the line is not wrapping,
+ * it is finished, so try the regular expression against it.
+ */
+void
+content_linefeed(struct window_pane *wp, int wrapped)
+{
+	struct content		*ct = wp->window->content;
+	struct screen		*s = &wp->base;
+	struct grid		*gd = s->grid;
+	u_int			 py;
+
+	if (ct == NULL)
+		return;
+
+	if (wrapped) {
+		/* Carry on at the start of the next line. */
+		wp->content_cx = 0;
+		if (s->cy != s->rlower && s->cy < screen_size_y(s) - 1)
+			wp->content_cy = s->cy + 1;
+		else
+			wp->content_cy = s->cy;
+		return;
+	}
+	wp->content_state = 0;
+
+	if (!ct->regex_used)
+		return;
+	py = gd->hsize + s->cy;
+	while (py > 0 && (gd->linedata[py - 1].flags & GRID_LINE_WRAPPED))
+		py--;
+	search_text_line(&content_text, gd, py);
+	if (regexec(&ct->regex, content_text.buf, 0, NULL, 0) == 0)
+		wp->window->flags |= WINDOW_CONTENT;
+}
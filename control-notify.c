@@ -19,139 +19,193 @@
 
 #include <sys/types.h>
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "tmux.h"
 
 #define CONTROL_SHOULD_NOTIFY_CLIENT(c) \
 	((c) != NULL && ((c)->flags & CLIENT_CONTROL))
 
+/*
+ * Each notification is built once and then written to every control client
+ * which wants it. Many clients are usually attached to the same few sessions,
+ * so whether a window is in a client's session is remembered for the last
+ * session looked at.
+ */
+struct control_notify_linked {
+	struct window	*window;
+	struct session	*session;
+	int		 linked;
+};
+
+int	control_notify_linked(struct control_notify_linked *, struct session *);
+
+/* Check if the window is linked into a session. */
+int
+control_notify_linked(struct control_notify_linked *cnl, struct session *s)
+{
+	if (s != cnl->session) {
+		cnl->session = s;
+		cnl->linked = (session_has(s, cnl->window) != NULL);
+	}
+	return (cnl->linked);
+}
+
+/*
+ * Write pane output to a client. encoded holds the output encoded as hex and
+ * compact, each made the first time a client needs it.
+ */
 void
-control_notify_input(struct client *c, struct window_pane *wp,
-    struct evbuffer *input)
+control_notify_input(struct client *c, struct window_pane *wp, u_char *buf,
+    size_t len, struct evbuffer **encoded)
 {
-	u_char		*buf;
-	size_t		 len;
-	struct evbuffer *message;
-	u_int		 i;
+	int	compact;
 
 	if (c->session == NULL)
 	    return;
 
-	buf = EVBUFFER_DATA(input);
-	len = EVBUFFER_LENGTH(input);
+	/* Check the client wants this pane before doing anything else. */
+	if (!control_want_output(c, wp))
+		return;
 
 	/*
 	 * Only write input if the window pane is linked to a window belonging
 	 * to the client's session.
 	 */
-	if (winlink_find_by_window(&c->session->windows, wp->window) != NULL) {
-		message = evbuffer_new();
-		evbuffer_add_printf(message, "%%output %%%u ", wp->id);
-		for (i = 0; i < len; i++)
-			evbuffer_add_printf(message, "%02hhx", buf[i]);
-		control_write_buffer(c, message);
-		evbuffer_free(message);
+	if (session_has(c->session, wp->window) == NULL)
+		return;
+
+	if (c->control_rate != 0) {
+		control_queue_output(c, wp, buf, len);
+		return;
+	}
+
+	compact = (c->flags & CLIENT_CONTROLCOMPACT) ? 1 : 0;
+	if (encoded[compact] == NULL) {
+		encoded[compact] = evbuffer_new();
+		control_encode_output(encoded[compact], buf, len, compact);
 	}
+	control_write_encoded(c, wp, encoded[compact]);
 }
 
 void
 control_notify_window_layout_changed(struct window *w)
 {
-	struct client		*c;
-	struct session		*s;
-	struct format_tree	*ft;
-	struct winlink		*wl;
-	u_int			 i;
-	const char		*template;
+	struct client			*c;
+	struct control_notify_linked	 cnl;
+	char				*layout, *msg;
+	u_int				 i;
 
+	/*
+	 * When the last pane in a window is closed it won't have a layout root
+	 * and we don't need to inform the client about the layout change
+	 * because the whole window will go away soon.
+	 */
+	if (w->layout_root == NULL)
+		return;
+
+	memset(&cnl, 0, sizeof cnl);
+	cnl.window = w;
+
+	msg = NULL;
 	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
 		c = ARRAY_ITEM(&clients, i);
 		if (!CONTROL_SHOULD_NOTIFY_CLIENT(c) || c->session == NULL)
 			continue;
-		s = c->session;
-
-		if (winlink_find_by_window_id(&s->windows, w->id) == NULL)
-			continue;
-
-		/*
-		 * When the last pane in a window is closed it won't have a
-		 * layout root and we don't need to inform the client about the
-		 * layout change because the whole window will go away soon.
-		 */
-		if (w->layout_root == NULL)
+		if (!control_notify_linked(&cnl, c->session))
 			continue;
-		template = "%layout-change #{window_id} #{window_layout}";
 
-		ft = format_create();
-		wl = winlink_find_by_window(&s->windows, w);
-		if (wl != NULL) {
-			format_winlink(ft, c->session, wl);
-			control_write(c, "%s", format_expand(ft, template));
+		if (msg == NULL) {
+			layout = layout_dump(w);
+			xasprintf(&msg, "%%layout-change @%u %s", w->id, layout);
+			free(layout);
 		}
-		format_free(ft);
+		control_write(c, "%s", msg);
 	}
+	free(msg);
 }
 
 void
 control_notify_window_unlinked(unused struct session *s, struct window *w)
 {
-	struct client	*c;
-	struct session	*cs;
-	u_int		 i;
+	struct client			*c;
+	struct control_notify_linked	 cnl;
+	char				*msg, *unlinked_msg;
+	u_int				 i;
 
+	memset(&cnl, 0, sizeof cnl);
+	cnl.window = w;
+
+	xasprintf(&msg, "%%window-close %u", w->id);
+	xasprintf(&unlinked_msg, "%%unlinked-window-close %u", w->id);
 	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
 		c = ARRAY_ITEM(&clients, i);
 		if (!CONTROL_SHOULD_NOTIFY_CLIENT(c) || c->session == NULL)
 			continue;
-		cs = c->session;
 
-		if (winlink_find_by_window_id(&cs->windows, w->id) != NULL)
-			control_write(c, "%%window-close %u", w->id);
+		if (control_notify_linked(&cnl, c->session))
+			control_write(c, "%s", msg);
 		else
-			control_write(c, "%%unlinked-window-close %u", w->id);
+			control_write(c, "%s", unlinked_msg);
 	}
+	free(msg);
+	free(unlinked_msg);
 }
 
 void
 control_notify_window_linked(unused struct session *s, struct window *w)
 {
-	struct client	*c;
-	struct session	*cs;
-	u_int		 i;
+	struct client			*c;
+	struct control_notify_linked	 cnl;
+	char				*msg, *unlinked_msg;
+	u_int				 i;
+
+	memset(&cnl, 0, sizeof cnl);
+	cnl.window = w;
 
+	xasprintf(&msg, "%%window-add %u", w->id);
+	xasprintf(&unlinked_msg, "%%unlinked-window-add %u", w->id);
 	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
 		c = ARRAY_ITEM(&clients, i);
 		if (!CONTROL_SHOULD_NOTIFY_CLIENT(c) || c->session == NULL)
 			continue;
-		cs = c->session;
 
-		if (winlink_find_by_window_id(&cs->windows, w->id) != NULL)
-			control_write(c, "%%window-add %u", w->id);
+		if (control_notify_linked(&cnl, c->session))
+			control_write(c, "%s", msg);
 		else
-			control_write(c, "%%unlinked-window-add %u", w->id);
+			control_write(c, "%s", unlinked_msg);
 	}
+	free(msg);
+	free(unlinked_msg);
 }
 
 void
 control_notify_window_renamed(struct window *w)
 {
-	struct client	*c;
-	struct session	*s;
-	u_int		 i;
+	struct client			*c;
+	struct control_notify_linked	 cnl;
+	char				*msg, *unlinked_msg;
+	u_int				 i;
 
+	memset(&cnl, 0, sizeof cnl);
+	cnl.window = w;
+
+	xasprintf(&msg, "%%window-renamed %u %s", w->id, w->name);
+	xasprintf(&unlinked_msg, "%%unlinked-window-renamed %u %s", w->id,
+	    w->name);
 	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
 		c = ARRAY_ITEM(&clients, i);
 		if (!CONTROL_SHOULD_NOTIFY_CLIENT(c) || c->session == NULL)
 			continue;
-		s = c->session;
-
-		if (winlink_find_by_window_id(&s->windows, w->id) != NULL) {
-			control_write(c, "%%window-renamed %u %s",
-			    w->id, w->name);
-		} else {
-			control_write(c, "%%unlinked-window-renamed %u %s",
-			    w->id, w->name);
-		}
+
+		if (control_notify_linked(&cnl, c->session))
+			control_write(c, "%s", msg);
+		else
+			control_write(c, "%s", unlinked_msg);
 	}
+	free(msg);
+	free(unlinked_msg);
 }
 
 void
@@ -28,6 +28,21 @@
 void printflike2 control_msg_error(struct cmd_ctx *, const char *, ...);
 void printflike2 control_msg_print(struct cmd_ctx *, const char *, ...);
 void printflike2 control_msg_info(struct cmd_ctx *, const char *, ...);
+void	control_timer(int, short, void *);
+
+RB_GENERATE(control_panes, control_pane, entry, control_pane_cmp);
+
+/* Size of the chunks in which %output is encoded. */
+#define CONTROL_OUTPUT_CHUNK 4096
+
+/* Client flags which may be set with refresh-client -F. */
+const struct {
+	const char	*name;
+	int		 flag;
+} control_flags[] = {
+	{ "compact-output", CLIENT_CONTROLCOMPACT },
+	{ "no-output", CLIENT_CONTROLNOOUTPUT },
+};
 
 /* Command error callback. */
 void printflike2
@@ -88,6 +103,372 @@ control_write_buffer(struct client *c, struct evbuffer *buffer)
 	server_push_stdout(c);
 }
 
+/*
+ * Encode pane output. By default every byte is written as two hex digits; with
+ * compact, printable ASCII is written as it is and anything else (and
+ * backslash) as a backslash and three octal digits. The output is encoded in
+ * chunks on the stack and added to the buffer.
+ */
+void
+control_encode_output(struct evbuffer *evb, const u_char *buf, size_t len,
+    int compact)
+{
+	static const char	 hex[] = "0123456789abcdef";
+	char			 out[CONTROL_OUTPUT_CHUNK + 4];
+	size_t			 i, used;
+	u_char			 ch;
+
+	used = 0;
+	if (compact) {
+		for (i = 0; i < len; i++) {
+			ch = buf[i];
+			if (ch >= ' ' && ch <= '~' && ch != '\\')
+				out[used++] = ch;
+			else {
+				out[used++] = '\\';
+				out[used++] = '0' + (ch >> 6);
+				out[used++] = '0' + ((ch >> 3) & 7);
+				out[used++] = '0' + (ch & 7);
+			}
+			if (used >= CONTROL_OUTPUT_CHUNK) {
+				evbuffer_add(evb, out, used);
+				used = 0;
+			}
+		}
+	} else {
+		for (i = 0; i < len; i++) {
+			ch = buf[i];
+			out[used++] = hex[ch >> 4];
+			out[used++] = hex[ch & 0xf];
+			if (used >= CONTROL_OUTPUT_CHUNK) {
+				evbuffer_add(evb, out, used);
+				used = 0;
+			}
+		}
+	}
+	evbuffer_add(evb, out, used);
+}
+
+/*
+ * Check if output from a pane may be written to a client. It may not if the
+ * pane is paused, and the pane is paused if too much is already waiting for
+ * the client, including what has been queued to send.
+ */
+int
+control_check_output(struct client *c, struct window_pane *wp)
+{
+	struct control_pane	*cp, find;
+	struct ibuf		*buf;
+	size_t			 limit, waiting;
+
+	if (!RB_EMPTY(&c->control_panes)) {
+		find.pane = wp->id;
+		cp = RB_FIND(control_panes, &c->control_panes, &find);
+		if (cp != NULL && (cp->flags & CONTROL_PANE_PAUSED))
+			return (0);
+	}
+
+	limit = options_get_number(&global_options, "control-output-limit");
+	if (limit != 0) {
+		waiting = EVBUFFER_LENGTH(c->stdout_data);
+		TAILQ_FOREACH(buf, &c->ibuf.w.bufs, entry)
+			waiting += buf->wpos - buf->rpos;
+		if (waiting >= limit) {
+			control_pause_pane(c, wp);
+			return (0);
+		}
+	}
+	return (1);
+}
+
+/* Write a %output line with pane output. */
+void
+control_write_output(struct client *c, struct window_pane *wp,
+    const u_char *buf, size_t len)
+{
+	if (!control_check_output(c, wp))
+		return;
+
+	evbuffer_add_printf(c->stdout_data, "%%output %%%u ", wp->id);
+	control_encode_output(c->stdout_data, buf, len,
+	    c->flags & CLIENT_CONTROLCOMPACT);
+	evbuffer_add(c->stdout_data, "\n", 1);
+	server_push_stdout(c);
+}
+
+/* Write a %output line with pane output which has already been encoded. */
+void
+control_write_encoded(struct client *c, struct window_pane *wp,
+    struct evbuffer *encoded)
+{
+	if (!control_check_output(c, wp))
+		return;
+
+	evbuffer_add_printf(c->stdout_data, "%%output %%%u ", wp->id);
+	evbuffer_add(c->stdout_data, EVBUFFER_DATA(encoded),
+	    EVBUFFER_LENGTH(encoded));
+	evbuffer_add(c->stdout_data, "\n", 1);
+	server_push_stdout(c);
+}
+
+int
+control_pane_cmp(struct control_pane *cp1, struct control_pane *cp2)
+{
+	if (cp1->pane < cp2->pane)
+		return (-1);
+	return (cp1->pane > cp2->pane);
+}
+
+/* Get the state for a pane, creating it if needed. */
+struct control_pane *
+control_get_pane(struct client *c, struct window_pane *wp)
+{
+	struct control_pane	*cp, find;
+
+	find.pane = wp->id;
+	if ((cp = RB_FIND(control_panes, &c->control_panes, &find)) != NULL)
+		return (cp);
+
+	cp = xcalloc(1, sizeof *cp);
+	cp->pane = wp->id;
+	RB_INSERT(control_panes, &c->control_panes, cp);
+	return (cp);
+}
+
+/* Free all pane state. */
+void
+control_free(struct client *c)
+{
+	struct control_pane	*cp;
+
+	while (!RB_EMPTY(&c->control_panes)) {
+		cp = RB_ROOT(&c->control_panes);
+		RB_REMOVE(control_panes, &c->control_panes, cp);
+		if (cp->pending != NULL)
+			evbuffer_free(cp->pending);
+		free(cp);
+	}
+
+	if (event_initialized(&c->control_timer))
+		evtimer_del(&c->control_timer);
+}
+
+/* Forget a pane which is being destroyed in every control client. */
+void
+control_remove_pane(struct window_pane *wp)
+{
+	struct client		*c;
+	struct control_pane	*cp, find;
+	u_int			 i;
+
+	find.pane = wp->id;
+	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
+		c = ARRAY_ITEM(&clients, i);
+		if (c == NULL || RB_EMPTY(&c->control_panes))
+			continue;
+		cp = RB_FIND(control_panes, &c->control_panes, &find);
+		if (cp == NULL)
+			continue;
+		RB_REMOVE(control_panes, &c->control_panes, cp);
+		if (cp->pending != NULL)
+			evbuffer_free(cp->pending);
+		free(cp);
+	}
+}
+
+/* Turn output from a pane on or off. */
+void
+control_set_pane(struct client *c, struct window_pane *wp, int on)
+{
+	struct control_pane	*cp;
+
+	cp = control_get_pane(c, wp);
+	if (on) {
+		cp->flags &= ~CONTROL_PANE_OFF;
+		cp->flags |= CONTROL_PANE_ON;
+	} else {
+		cp->flags &= ~CONTROL_PANE_ON;
+		cp->flags |= CONTROL_PANE_OFF;
+		if (cp->pending != NULL)
+			evbuffer_drain(cp->pending, EVBUFFER_LENGTH(cp->pending));
+	}
+}
+
+/*
+ * Check if a client wants output from a pane: not if it is paused or turned
+ * off, and with no-output only if it has been turned on.
+ */
+int
+control_want_output(struct client *c, struct window_pane *wp)
+{
+	struct control_pane	*cp, find;
+
+	if (!RB_EMPTY(&c->control_panes)) {
+		find.pane = wp->id;
+		cp = RB_FIND(control_panes, &c->control_panes, &find);
+		if (cp != NULL) {
+			if (cp->flags & (CONTROL_PANE_PAUSED|CONTROL_PANE_OFF))
+				return (0);
+			if (cp->flags & CONTROL_PANE_ON)
+				return (1);
+		}
+	}
+	return (!(c->flags & CLIENT_CONTROLNOOUTPUT));
+}
+
+/*
+ * Keep output from a pane to be sent when the output timer fires, so a pane
+ * is sent as one %output at most once every output-rate milliseconds.
+ */
+void
+control_queue_output(struct client *c, struct window_pane *wp,
+    const u_char *buf, size_t len)
+{
+	struct control_pane	*cp;
+	struct timeval		 tv;
+	size_t			 limit;
+
+	cp = control_get_pane(c, wp);
+	if (cp->pending == NULL)
+		cp->pending = evbuffer_new();
+
+	limit = options_get_number(&global_options, "control-output-limit");
+	if (limit != 0 && EVBUFFER_LENGTH(cp->pending) + len >= limit) {
+		evbuffer_drain(cp->pending, EVBUFFER_LENGTH(cp->pending));
+		control_pause_pane(c, wp);
+		return;
+	}
+	evbuffer_add(cp->pending, buf, len);
+
+	if (!event_initialized(&c->control_timer))
+		evtimer_set(&c->control_timer, control_timer, c);
+	if (!evtimer_pending(&c->control_timer, NULL)) {
+		tv.tv_sec = c->control_rate / 1000;
+		tv.tv_usec = (c->control_rate % 1000) * 1000L;
+		evtimer_add(&c->control_timer, &tv);
+	}
+}
+
+/* Output timer: send everything waiting. */
+/* ARGSUSED */
+void
+control_timer(unused int fd, unused short events, void *data)
+{
+	struct client		*c = data;
+	struct control_pane	*cp;
+	struct window_pane	*wp;
+	size_t			 len;
+
+	RB_FOREACH(cp, control_panes, &c->control_panes) {
+		if (cp->pending == NULL)
+			continue;
+		len = EVBUFFER_LENGTH(cp->pending);
+		if (len == 0)
+			continue;
+		wp = window_pane_find_by_id(cp->pane);
+		if (wp != NULL && !(cp->flags & CONTROL_PANE_PAUSED))
+			control_write_output(c, wp, EVBUFFER_DATA(cp->pending), len);
+		evbuffer_drain(cp->pending, len);
+	}
+}
+
+/* Stop sending output for a pane until the client asks for it again. */
+void
+control_pause_pane(struct client *c, struct window_pane *wp)
+{
+	struct control_pane	*cp;
+
+	cp = control_get_pane(c, wp);
+	if (cp->flags & CONTROL_PANE_PAUSED)
+		return;
+	cp->flags |= CONTROL_PANE_PAUSED;
+	control_write(c, "%%pause %%%u", wp->id);
+}
+
+/*
+ * Start sending output for a paused pane again. Whatever was missed is gone,
+ * so start with the current contents of the screen.
+ */
+void
+control_continue_pane(struct client *c, struct window_pane *wp)
+{
+	struct control_pane	*cp;
+	struct screen		*s = &wp->base;
+	struct grid		*gd = s->grid;
+	struct grid_cell	 lastgc;
+	struct evbuffer		*evb;
+	u_int			 yy;
+
+	cp = control_get_pane(c, wp);
+	if (!(cp->flags & CONTROL_PANE_PAUSED))
+		return;
+	cp->flags &= ~CONTROL_PANE_PAUSED;
+	control_write(c, "%%continue %%%u", wp->id);
+
+	evb = evbuffer_new();
+	evbuffer_add_printf(evb, "\033[r\033[H\033[2J");
+	memcpy(&lastgc, &grid_default_cell, sizeof lastgc);
+	for (yy = 0; yy < screen_size_y(s); yy++) {
+		if (yy != 0)
+			evbuffer_add(evb, "\r\n", 2);
+		grid_string_line(gd, gd->hsize + yy, screen_size_x(s), evb,
+		    &lastgc);
+	}
+	grid_string_code(&grid_default_cell, &lastgc, evb);
+	evbuffer_add_printf(evb, "\033[%u;%uH", s->cy + 1, s->cx + 1);
+
+	control_write_output(c, wp, EVBUFFER_DATA(evb), EVBUFFER_LENGTH(evb));
+	evbuffer_free(evb);
+}
+
+/*
+ * Set or clear (with a leading !) a comma-separated list of control client
+ * flags. output-rate=ms is also accepted.
+ */
+int
+control_set_flags(struct client *c, const char *flags, char **cause)
+{
+	char		*copy, *next, *s;
+	const char	*errstr;
+	u_int		 i, rate;
+	int		 not;
+
+	copy = next = xstrdup(flags);
+	while ((s = strsep(&next, ",")) != NULL) {
+		if (*s == '\0')
+			continue;
+		if (strncmp(s, "output-rate=", 12) == 0) {
+			rate = strtonum(s + 12, 0, 60000, &errstr);
+			if (errstr != NULL) {
+				xasprintf(cause, "output-rate %s", errstr);
+				free(copy);
+				return (-1);
+			}
+			c->control_rate = rate;
+			continue;
+		}
+
+		not = (*s == '!');
+		if (not)
+			s++;
+		for (i = 0; i < nitems(control_flags); i++) {
+			if (strcmp(control_flags[i].name, s) == 0)
+				break;
+		}
+		if (i == nitems(control_flags)) {
+			xasprintf(cause, "unknown flag: %s", s);
+			free(copy);
+			return (-1);
+		}
+		if (not)
+			c->flags &= ~control_flags[i].flag;
+		else
+			c->flags |= control_flags[i].flag;
+	}
+	free(copy);
+	return (0);
+}
+
 /* Control input callback. Read lines and fire commands. */
 void
 control_callback(struct client *c, int closed, unused void *data)
@@ -152,27 +152,38 @@ environ_update(const char *vars, struct environ *srcenv, struct environ *dstenv)
 	free(copyvars);
 }
 
-/* Push environment into the real environment - use after fork(). */
-void
-environ_push(struct environ *env)
+/*
+ * Build a NULL-terminated array of "name=value" strings from an environment,
+ * for passing to execve(2).
+ */
+char **
+environ_array(struct environ *env)
 {
-	ARRAY_DECL(, char *)	varlist;
-	struct environ_entry   *envent;
-	char		      **varp, *var;
-	u_int			i;
-
-	ARRAY_INIT(&varlist);
-	for (varp = environ; *varp != NULL; varp++) {
-		var = xstrdup(*varp);
-		var[strcspn(var, "=")] = '\0';
-		ARRAY_ADD(&varlist, var);
-	}
-	for (i = 0; i < ARRAY_LENGTH(&varlist); i++)
-		unsetenv(ARRAY_ITEM(&varlist, i));
-	ARRAY_FREE(&varlist);
+	struct environ_entry	*envent;
+	char		       **envp;
+	u_int			 n;
+
+	n = 0;
+	RB_FOREACH(envent, environ, env)
+		n++;
+	envp = xcalloc(n + 1, sizeof *envp);
 
+	n = 0;
 	RB_FOREACH(envent, environ, env) {
 		if (envent->value != NULL)
-			setenv(envent->name, envent->value, 1);
+			xasprintf(&envp[n++], "%s=%s", envent->name, envent->value);
 	}
+	envp[n] = NULL;
+	return (envp);
+}
+
+/* Free an array from environ_array. */
+void
+environ_free_array(char **envp)
+{
+	char	**varp;
+
+	for (varp = envp; *varp != NULL; varp++)
+		free(*varp);
+	free(envp);
 }
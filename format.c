@@ -34,6 +34,9 @@
 
 int	format_replace(struct format_tree *,
 	    const char *, size_t, char **, size_t *, size_t *);
+int	format_lazy(struct format_tree *, const char *);
+void	format_status_jobs(struct format_tree *);
+void	format_stats(struct format_tree *);
 
 /* Format key-value replacement entry. */
 RB_GENERATE(format_tree, format_entry, entry, format_cmp);
@@ -91,6 +94,62 @@ format_create(void)
 	return (ft);
 }
 
+/*
+ * Add formats which are costly to work out and rarely wanted the first time
+ * one of them is looked up. Returns 1 if any were added.
+ */
+int
+format_lazy(struct format_tree *ft, const char *key)
+{
+	if (strncmp(key, "status_job", 10) == 0) {
+		format_status_jobs(ft);
+		return (1);
+	}
+	if (strncmp(key, "stats_", 6) == 0) {
+		format_stats(ft);
+		return (1);
+	}
+	return (0);
+}
+
+/* Add status line job statistics. */
+void
+format_status_jobs(struct format_tree *ft)
+{
+	struct status_out	*so;
+	u_int			 n, running, latency, failures;
+
+	n = running = latency = failures = 0;
+	RB_FOREACH(so, status_out_tree, &status_jobs) {
+		n++;
+		if (so->job != NULL)
+			running++;
+		if (so->latency > latency)
+			latency = so->latency;
+		failures += so->failures;
+	}
+
+	format_add(ft, "status_jobs", "%u", n);
+	format_add(ft, "status_jobs_running", "%u", running);
+	format_add(ft, "status_job_latency", "%u", latency);
+	format_add(ft, "status_job_failures", "%u", failures);
+}
+
+/* Add server statistics. */
+void
+format_stats(struct format_tree *ft)
+{
+	format_add(ft, "stats_loops", "%llu", global_stats.loops);
+	format_add(ft, "stats_pane_bytes", "%llu", global_stats.pane_bytes);
+	format_add(ft, "stats_input_bytes", "%llu", global_stats.input_bytes);
+	format_add(ft, "stats_input_cells", "%llu", global_stats.input_cells);
+	format_add(ft, "stats_tty_bytes", "%llu", global_stats.tty_bytes);
+	format_add(ft, "stats_redraws", "%llu", global_stats.redraws);
+	format_add(ft, "stats_format_expands", "%llu",
+	    global_stats.format_expands);
+	format_add(ft, "stats_job_forks", "%llu", global_stats.job_forks);
+}
+
 /* Free a tree. */
 void
 format_free(struct format_tree *ft)
@@ -115,7 +174,7 @@ format_free(struct format_tree *ft)
 void
 format_add(struct format_tree *ft, const char *key, const char *fmt, ...)
 {
-	struct format_entry	*fe;
+	struct format_entry	*fe, *fe_now;
 	va_list			 ap;
 
 	fe = xmalloc(sizeof *fe);
@@ -125,7 +184,14 @@ format_add(struct format_tree *ft, const char *key, const char *fmt, ...)
 	xvasprintf(&fe->value, fmt, ap);
 	va_end(ap);
 
-	RB_INSERT(format_tree, ft, fe);
+	/* Replace the value if the key is already there. */
+	fe_now = RB_INSERT(format_tree, ft, fe);
+	if (fe_now != NULL) {
+		free(fe_now->value);
+		fe_now->value = fe->value;
+		free(fe->key);
+		free(fe);
+	}
 }
 
 /* Find a format entry. */
@@ -136,6 +202,8 @@ format_find(struct format_tree *ft, const char *key)
 
 	fe_find.key = (char *) key;
 	fe = RB_FIND(format_tree, ft, &fe_find);
+	if (fe == NULL && format_lazy(ft, key))
+		fe = RB_FIND(format_tree, ft, &fe_find);
 	if (fe == NULL)
 		return (NULL);
 	return (fe->value);
@@ -213,6 +281,8 @@ format_expand(struct format_tree *ft, const char *fmt)
 	size_t		 off, len, n;
 	int     	 ch;
 
+	global_stats.format_expands++;
+
 	len = 64;
 	buf = xmalloc(len);
 	off = 0;
@@ -330,6 +400,15 @@ format_client(struct format_tree *ft, struct client *c)
 		format_add(ft, "client_readonly", "%d", 1);
 	else
 		format_add(ft, "client_readonly", "%d", 0);
+
+	format_add(ft, "client_tty_bytes", "%llu", c->tty.bytes);
+	format_add(ft, "client_redraws", "%u", c->tty.redraws);
+
+	format_add(ft, "client_latency_keys", "%u", c->key_latency.count);
+	format_add(ft, "client_latency_p50", "%u",
+	    latency_percentile(&c->key_latency, 50));
+	format_add(ft, "client_latency_p99", "%u",
+	    latency_percentile(&c->key_latency, 99));
 }
 
 /* Set default format keys for a winlink. */
@@ -387,6 +466,12 @@ format_window_pane(struct format_tree *ft, struct window_pane *wp)
 	format_add(ft, "pane_id", "%%%u", wp->id);
 	format_add(ft, "pane_active", "%d", wp == wp->window->active);
 	format_add(ft, "pane_dead", "%d", wp->fd == -1);
+	format_add(ft, "pane_bytes", "%llu", wp->bytes);
+	format_add(ft, "pane_generation", "%llu", gd->generation);
+	format_add(ft, "pane_search_index", "%zu", grid_index_size(gd));
+	format_add(ft, "pane_recording", "%d", wp->record != NULL);
+	format_add(ft, "pane_pipe", "%d", !TAILQ_EMPTY(&wp->pipes));
+	format_add(ft, "pane_pipe_dropped", "%llu", pipe_dropped(wp));
 	if (wp->cmd != NULL)
 		format_add(ft, "pane_start_command", "%s", wp->cmd);
 	if (wp->cwd != NULL)
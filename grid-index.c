@@ -0,0 +1,632 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Nicholas Marriott <nicm@users.sourceforge.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/types.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tmux.h"
+
+/*
+ * Index of the history of a grid for searching. The history is split into
+ * blocks of GRID_INDEX_BLOCK lines, numbered from the first line the pane ever
+ * had so the numbers do not change as history is collected. For every
+ * trigram (three consecutive bytes) in the history, the index keeps the list
+ * of blocks with a logical line starting in them which contains it. A search
+ * for a string of three or more bytes then only needs to look at the blocks
+ * which have every one of its trigrams.
+ *
+ * Lines are added as they scroll into history, once the logical line they
+ * are part of has ended, and a block is added once all its lines are in. Only
+ * the complete logical lines between first and next are covered; lines
+ * outside that (the start of history if the index was limited or a line was
+ * cut in two by collection, and the end of history and the screen) must be
+ * searched directly.
+ *
+ * Each list is stored as the differences between block numbers, seven bits
+ * to a byte, so most take one byte. Trigrams are looked up for every block,
+ * so they are kept in an open addressed hash table rather than a tree.
+ */
+
+/* Lines in each block. */
+#define GRID_INDEX_BLOCK 16
+
+/* Initial number of trigrams the table can hold. */
+#define GRID_INDEX_SLOTS 256
+
+/* Size of the filter for trigrams already seen in a block. */
+#define GRID_INDEX_SEEN 1024
+
+struct grid_index_entry {
+	u_int		 key;	/* trigram plus one, 0 if slot is unused */
+
+	u_char		*data;
+	u_int		 used;
+	u_int		 size;
+
+	u_int		 base;	/* block before the first in the list */
+	u_int		 last;	/* last block in the list */
+};
+
+struct grid_index_cursor {
+	struct grid_index_entry	*e;
+	u_int			 pos;
+	u_int			 block;
+};
+
+struct grid_index {
+	struct grid_index_entry	*table;
+	u_int			 slots;
+	u_int			 bits;
+	u_int			 keys;
+
+	u_int			 first;
+	u_int			 next;
+	u_int			 scan;	/* next line to read */
+	u_int			 wrap;	/* open line is wrapped up to here */
+
+	u_int			 block;	/* block being read */
+	u_int			*pending;
+	u_int			 npending;
+	u_int			 spending;
+	u_int			 seen[GRID_INDEX_SEEN];
+
+	size_t			 limit;
+	size_t			 size;
+};
+
+void	grid_index_clear(struct grid_index *);
+struct grid_index_entry *grid_index_find(struct grid_index *, u_int, int);
+void	grid_index_grow(struct grid_index *);
+void	grid_index_read(struct grid_index *, struct grid *, u_int);
+void	grid_index_flush(struct grid_index *);
+void	grid_index_append(struct grid_index *, struct grid_index_entry *,
+	    u_int);
+int	grid_index_next(struct grid_index_cursor *);
+void	grid_index_prune(struct grid_index *, u_int);
+void	grid_index_drop(struct grid *, u_int);
+void	grid_index_limit(struct grid *);
+
+/* Start, stop or change the memory limit of the index for a grid. */
+void
+grid_index_set(struct grid *gd, size_t limit)
+{
+	struct grid_index	*ix = gd->index;
+
+	if (limit == 0) {
+		grid_index_free(gd);
+		return;
+	}
+
+	if (ix == NULL) {
+		ix = gd->index = xcalloc(1, sizeof *ix);
+		ix->first = ix->next = ix->scan = ix->wrap = gd->hremoved;
+		ix->block = gd->hremoved / GRID_INDEX_BLOCK;
+		ix->size = sizeof *ix;
+	}
+	ix->limit = limit;
+	grid_index_update(gd);
+}
+
+/* Free the index. */
+void
+grid_index_free(struct grid *gd)
+{
+	struct grid_index	*ix = gd->index;
+
+	if (ix == NULL)
+		return;
+
+	grid_index_clear(ix);
+	free(ix->pending);
+	free(ix);
+
+	gd->index = NULL;
+}
+
+/* Throw away all the trigrams. */
+void
+grid_index_clear(struct grid_index *ix)
+{
+	u_int	i;
+
+	for (i = 0; i < ix->slots; i++)
+		free(ix->table[i].data);
+	free(ix->table);
+
+	ix->table = NULL;
+	ix->slots = ix->bits = ix->keys = 0;
+	ix->size = sizeof *ix + ix->spending * sizeof *ix->pending;
+}
+
+/* Find the entry for a trigram, optionally adding it if it is missing. */
+struct grid_index_entry *
+grid_index_find(struct grid_index *ix, u_int key, int create)
+{
+	struct grid_index_entry	*e;
+	u_int			 i;
+
+	key++;
+	if (ix->slots == 0) {
+		if (!create)
+			return (NULL);
+		grid_index_grow(ix);
+	}
+
+	i = (key * 2654435761U) >> (32 - ix->bits);
+	for (;;) {
+		e = &ix->table[i];
+		if (e->key == key)
+			return (e);
+		if (e->key == 0)
+			break;
+		i = (i + 1) & (ix->slots - 1);
+	}
+	if (!create)
+		return (NULL);
+
+	if ((ix->keys + 1) * 2 > ix->slots) {
+		grid_index_grow(ix);
+		return (grid_index_find(ix, key - 1, create));
+	}
+	e->key = key;
+	ix->keys++;
+	return (e);
+}
+
+/* Double the size of the hash table. */
+void
+grid_index_grow(struct grid_index *ix)
+{
+	struct grid_index_entry	*old = ix->table, *e;
+	u_int			 oldslots = ix->slots, i, j;
+
+	if (ix->slots == 0) {
+		ix->slots = GRID_INDEX_SLOTS;
+		ix->bits = 8;
+	} else {
+		ix->slots *= 2;
+		ix->bits++;
+	}
+	ix->table = xcalloc(ix->slots, sizeof *ix->table);
+	ix->size += (ix->slots - oldslots) * sizeof *ix->table;
+
+	for (i = 0; i < oldslots; i++) {
+		e = &old[i];
+		if (e->key == 0)
+			continue;
+		j = (e->key * 2654435761U) >> (32 - ix->bits);
+		while (ix->table[j].key != 0)
+			j = (j + 1) & (ix->slots - 1);
+		memcpy(&ix->table[j], e, sizeof ix->table[j]);
+	}
+	free(old);
+}
+
+/*
+ * Read the trigrams of the logical line starting at a grid line into the
+ * block being built. Trigrams already seen in this block are mostly skipped.
+ */
+void
+grid_index_read(struct grid_index *ix, struct grid *gd, u_int py)
+{
+	const struct grid_line	*gl;
+	const struct grid_cell	*gc;
+	const struct grid_utf8	*gu;
+	const u_char		*data;
+	u_int			 px, key, n, h;
+	size_t			 size, i;
+
+	key = n = 0;
+	for (; py < gd->hsize + gd->sy; py++) {
+		gl = &gd->linedata[py];
+		for (px = 0; px < gl->cellsize; px++) {
+			gc = &gl->celldata[px];
+			if (gc->flags & GRID_FLAG_PADDING)
+				continue;
+			if (gc->flags & GRID_FLAG_UTF8) {
+				gu = &gl->utf8data[px];
+				data = gu->data;
+				size = grid_utf8_size(gu);
+			} else {
+				data = &gc->data;
+				size = 1;
+			}
+
+			for (i = 0; i < size; i++) {
+				key = ((key << 8) | data[i]) & 0xffffff;
+				if (++n < 3)
+					continue;
+
+				h = (key * 2654435761U) >> 22;
+				if (ix->seen[h] == key + 1)
+					continue;
+				ix->seen[h] = key + 1;
+
+				if (ix->npending == ix->spending) {
+					ix->size -= ix->spending *
+					    sizeof *ix->pending;
+					ix->spending = ix->spending == 0 ?
+					    256 : ix->spending * 2;
+					ix->pending = xrealloc(ix->pending,
+					    ix->spending, sizeof *ix->pending);
+					ix->size += ix->spending *
+					    sizeof *ix->pending;
+				}
+				ix->pending[ix->npending++] = key;
+			}
+		}
+		if (!(gl->flags & GRID_LINE_WRAPPED))
+			break;
+	}
+}
+
+/* Add a block to the list for a trigram. */
+void
+grid_index_append(struct grid_index *ix, struct grid_index_entry *e,
+    u_int block)
+{
+	u_int	delta;
+
+	delta = block - (e->used == 0 ? e->base : e->last);
+	if (e->used + 5 > e->size) {
+		ix->size -= e->size;
+		e->size = e->size == 0 ? 8 : e->size * 2;
+		e->data = xrealloc(e->data, 1, e->size);
+		ix->size += e->size;
+	}
+	while (delta >= 0x80) {
+		e->data[e->used++] = (delta & 0x7f) | 0x80;
+		delta >>= 7;
+	}
+	e->data[e->used++] = delta;
+	e->last = block;
+}
+
+/* Add the block being built to the lists for all its trigrams. */
+void
+grid_index_flush(struct grid_index *ix)
+{
+	struct grid_index_entry	*e;
+	u_int			 i;
+
+	for (i = 0; i < ix->npending; i++) {
+		e = grid_index_find(ix, ix->pending[i], 1);
+		if (e->used == 0 || e->last != ix->block)
+			grid_index_append(ix, e, ix->block);
+	}
+	ix->npending = 0;
+	memset(ix->seen, 0, sizeof ix->seen);
+}
+
+/* Move a cursor to the next block in a list. Returns 0 at the end. */
+int
+grid_index_next(struct grid_index_cursor *c)
+{
+	struct grid_index_entry	*e = c->e;
+	u_int			 delta, shift;
+
+	if (c->pos == e->used)
+		return (0);
+
+	delta = shift = 0;
+	do {
+		delta |= (e->data[c->pos] & 0x7f) << shift;
+		shift += 7;
+	} while (e->data[c->pos++] & 0x80);
+	c->block += delta;
+	return (1);
+}
+
+/* Remove blocks before a block from every list. */
+void
+grid_index_prune(struct grid_index *ix, u_int block)
+{
+	struct grid_index_entry		*e;
+	struct grid_index_cursor	 c;
+	u_int				 i, pos;
+
+	for (i = 0; i < ix->slots; i++) {
+		e = &ix->table[i];
+		if (e->key == 0 || e->used == 0)
+			continue;
+
+		c.e = e;
+		c.pos = 0;
+		c.block = e->base;
+		for (;;) {
+			pos = c.pos;
+			e->base = c.block;
+			if (!grid_index_next(&c) || c.block >= block)
+				break;
+		}
+		if (pos == 0)
+			continue;
+
+		e->used -= pos;
+		memmove(e->data, e->data + pos, e->used);
+		if (e->used < e->size / 4) {
+			ix->size -= e->size;
+			e->size = e->used == 0 ? 0 : e->used + 5;
+			if (e->size == 0) {
+				free(e->data);
+				e->data = NULL;
+			} else
+				e->data = xrealloc(e->data, 1, e->size);
+			ix->size += e->size;
+		}
+	}
+}
+
+/*
+ * Stop covering the lines before a grid line, which must start a logical line
+ * or be the end of the history.
+ */
+void
+grid_index_drop(struct grid *gd, u_int py)
+{
+	struct grid_index	*ix = gd->index;
+
+	ix->first = gd->hremoved + py;
+	if (ix->next < ix->first) {
+		/* The block being built has lost lines, so start it again. */
+		ix->next = ix->scan = ix->first;
+		ix->npending = 0;
+		memset(ix->seen, 0, sizeof ix->seen);
+	}
+	if (ix->scan < ix->first)
+		ix->scan = ix->first;
+
+	if (ix->first == ix->next)
+		grid_index_clear(ix);
+	else
+		grid_index_prune(ix, ix->first / GRID_INDEX_BLOCK);
+}
+
+/* Drop the oldest lines until the index fits in its limit. */
+void
+grid_index_limit(struct grid *gd)
+{
+	struct grid_index	*ix = gd->index;
+	u_int			 py, end;
+
+	while (ix->size > ix->limit && ix->first != ix->next) {
+		py = ix->first - gd->hremoved;
+		end = ix->next - gd->hremoved;
+
+		py += (end - py) / 10;
+		if (py == ix->first - gd->hremoved)
+			py++;
+		while (py < end &&
+		    (gd->linedata[py - 1].flags & GRID_LINE_WRAPPED))
+			py++;
+		grid_index_drop(gd, py);
+	}
+}
+
+/*
+ * Add any lines which have ended in the history since the last update. Called
+ * whenever a line scrolls into history and before the index is used.
+ */
+void
+grid_index_update(struct grid *gd)
+{
+	struct grid_index	*ix = gd->index;
+	u_int			 py, last, block;
+
+	if (ix == NULL)
+		return;
+
+	py = ix->scan - gd->hremoved;
+	while (py < gd->hsize) {
+		/*
+		 * Stop at a line which carries on onto the screen, remembering
+		 * how far it has been checked so it is not walked again.
+		 */
+		last = py;
+		if (ix->wrap > gd->hremoved + last)
+			last = ix->wrap - gd->hremoved;
+		while (last < gd->hsize &&
+		    (gd->linedata[last].flags & GRID_LINE_WRAPPED))
+			last++;
+		if (last >= gd->hsize) {
+			ix->wrap = gd->hremoved + last;
+			break;
+		}
+
+		/* A line in a new block means the last one is complete. */
+		block = (gd->hremoved + py) / GRID_INDEX_BLOCK;
+		if (block != ix->block) {
+			grid_index_flush(ix);
+			ix->block = block;
+			ix->next = gd->hremoved + py;
+		}
+
+		grid_index_read(ix, gd, py);
+		py = last + 1;
+	}
+	ix->scan = gd->hremoved + py;
+
+	if (ix->size > ix->limit)
+		grid_index_limit(gd);
+}
+
+/*
+ * Lines are about to be removed from the top of the history. Any logical
+ * line which starts in them is no longer covered, including the rest of it
+ * which stays in the history.
+ */
+void
+grid_index_remove(struct grid *gd, u_int ny)
+{
+	struct grid_index	*ix = gd->index;
+	u_int			 py;
+
+	if (ix == NULL)
+		return;
+
+	py = ny;
+	while (py < gd->hsize &&
+	    py != 0 && (gd->linedata[py - 1].flags & GRID_LINE_WRAPPED))
+		py++;
+	if (gd->hremoved + py > ix->first)
+		grid_index_drop(gd, py);
+}
+
+/*
+ * Lines have been taken back out of the bottom of the history (when the pane
+ * gets taller). Forget the blocks which are no longer complete and read them
+ * again when they are.
+ */
+void
+grid_index_truncate(struct grid *gd)
+{
+	struct grid_index		*ix = gd->index;
+	struct grid_index_entry		*e;
+	struct grid_index_cursor	 c;
+	u_int				 py, block, i, pos;
+
+	if (ix == NULL)
+		return;
+
+	py = gd->hsize;
+	while (py != 0 && (gd->linedata[py - 1].flags & GRID_LINE_WRAPPED))
+		py--;
+	if (ix->scan <= gd->hremoved + py)
+		return;
+	block = (gd->hremoved + py) / GRID_INDEX_BLOCK;
+
+	/* Go back to the first logical line starting in the block. */
+	if (block * GRID_INDEX_BLOCK > ix->first)
+		py = block * GRID_INDEX_BLOCK - gd->hremoved;
+	else
+		py = ix->first - gd->hremoved;
+	while (py != 0 && (gd->linedata[py - 1].flags & GRID_LINE_WRAPPED))
+		py++;
+
+	for (i = 0; i < ix->slots; i++) {
+		e = &ix->table[i];
+		if (e->key == 0 || e->used == 0 || e->last < block)
+			continue;
+
+		c.e = e;
+		c.pos = 0;
+		c.block = e->base;
+		for (;;) {
+			pos = c.pos;
+			e->last = c.block;
+			if (!grid_index_next(&c) || c.block >= block)
+				break;
+		}
+		e->used = pos;
+	}
+
+	ix->scan = ix->next = ix->wrap = gd->hremoved + py;
+	ix->block = block;
+	ix->npending = 0;
+	memset(ix->seen, 0, sizeof ix->seen);
+	if (ix->first > ix->next)
+		ix->first = ix->next;
+}
+
+/*
+ * Find the lines in history which may contain a search string. Fills in the
+ * ranges of grid lines in which the candidate logical lines start and the
+ * lines that the index covers, outside which the grid must be searched
+ * directly. Returns -1 if the index cannot be used for this search.
+ */
+int
+grid_index_lookup(struct grid *gd, struct search *sr,
+    struct grid_index_ranges *ranges, u_int *first, u_int *last)
+{
+	struct grid_index		*ix = gd->index;
+	struct grid_index_cursor	*cursors, *c, *shortest;
+	struct grid_index_range		*r, new;
+	const u_char			*s = (const u_char *) sr->string;
+	u_int				 n, i, key;
+
+	if (ix == NULL || (sr->flags & SEARCH_REGEX) || sr->len < 3)
+		return (-1);
+	grid_index_update(gd);
+
+	*first = ix->first - gd->hremoved;
+	*last = ix->next - gd->hremoved;
+	if (ix->first == ix->next)
+		return (0);
+
+	n = sr->len - 2;
+	cursors = xcalloc(n, sizeof *cursors);
+	shortest = NULL;
+	for (i = 0; i < n; i++) {
+		c = &cursors[i];
+		key = (s[i] << 16) | (s[i + 1] << 8) | s[i + 2];
+		if ((c->e = grid_index_find(ix, key, 0)) == NULL ||
+		    c->e->used == 0)
+			goto out;
+		c->pos = 0;
+		c->block = c->e->base;
+		if (shortest == NULL || c->e->used < shortest->e->used)
+			shortest = c;
+	}
+
+	/* Walk the shortest list and look for each block in the others. */
+	while (grid_index_next(shortest)) {
+		for (i = 0; i < n; i++) {
+			c = &cursors[i];
+			if (c == shortest)
+				continue;
+			while (c->block < shortest->block || c->pos == 0) {
+				if (!grid_index_next(c))
+					goto out;
+			}
+			if (c->block != shortest->block)
+				break;
+		}
+		if (i != n)
+			continue;
+
+		new.start = shortest->block * GRID_INDEX_BLOCK;
+		new.end = new.start + GRID_INDEX_BLOCK;
+		if (new.start < gd->hremoved)
+			new.start = gd->hremoved;
+		new.start -= gd->hremoved;
+		new.end -= gd->hremoved;
+		if (new.end > *last)
+			new.end = *last;
+
+		r = ARRAY_EMPTY(ranges) ? NULL : &ARRAY_LAST(ranges);
+		if (r != NULL && r->end == new.start)
+			r->end = new.end;
+		else
+			ARRAY_ADD(ranges, new);
+	}
+
+out:
+	free(cursors);
+	return (0);
+}
+
+/* Get the memory used by the index. */
+size_t
+grid_index_size(struct grid *gd)
+{
+	if (gd->index == NULL)
+		return (0);
+	return (gd->index->size);
+}
@@ -47,6 +47,9 @@ const struct grid_cell grid_marker_cell = { 0, 0, 8, 8, '_' };
 	memcpy(&gd->linedata[py].utf8data[px], 			\
 	    gc, sizeof gd->linedata[py].utf8data[px]);		\
 } while (0)
+#define grid_changed(gd, py) do {				\
+	gd->linedata[py].generation = ++gd->generation;		\
+} while (0)
 
 int	grid_check_y(struct grid *, u_int);
 
@@ -84,9 +87,13 @@ grid_create(u_int sx, u_int sy, u_int hlimit)
 
 	gd->hsize = 0;
 	gd->hlimit = hlimit;
+	gd->hremoved = 0;
 
+	gd->generation = 0;
 	gd->linedata = xcalloc(gd->sy, sizeof *gd->linedata);
 
+	gd->index = NULL;
+
 	return (gd);
 }
 
@@ -105,6 +112,7 @@ grid_destroy(struct grid *gd)
 
 	free(gd->linedata);
 
+	grid_index_free(gd);
 	free(gd);
 }
 
@@ -144,12 +152,13 @@ grid_compare(struct grid *ga, struct grid *gb)
 
 /*
  * Collect lines from the history if at the limit. Free the top (oldest) 10%
- * and shift up.
+ * and shift up. The lines which are left have not changed, they are just
+ * further up, so they keep their generation.
  */
 void
 grid_collect_history(struct grid *gd)
 {
-	u_int	yy;
+	u_int	yy, ny;
 
 	GRID_DEBUG(gd, "");
 
@@ -159,9 +168,15 @@ grid_collect_history(struct grid *gd)
 	yy = gd->hlimit / 10;
 	if (yy < 1)
 		yy = 1;
+	ny = gd->hsize + gd->sy - yy;
+
+	grid_index_remove(gd, yy);
+	grid_clear_lines(gd, 0, yy);
+	memmove(&gd->linedata[0], &gd->linedata[yy], ny * sizeof *gd->linedata);
+	memset(&gd->linedata[ny], 0, yy * sizeof *gd->linedata);
 
-	grid_move_lines(gd, 0, yy, gd->hsize + gd->sy - yy);
 	gd->hsize -= yy;
+	gd->hremoved += yy;
 }
 
 /*
@@ -178,8 +193,10 @@ grid_scroll_history(struct grid *gd)
 	yy = gd->hsize + gd->sy;
 	gd->linedata = xrealloc(gd->linedata, yy + 1, sizeof *gd->linedata);
 	memset(&gd->linedata[yy], 0, sizeof gd->linedata[yy]);
+	grid_changed(gd, yy);
 
 	gd->hsize++;
+	grid_index_update(gd);
 }
 
 /* Scroll a region up, moving the top line into the history. */
@@ -212,8 +229,25 @@ grid_scroll_history_region(struct grid *gd, u_int upper, u_int lower)
 	memmove(gl_upper, gl_upper + 1, (lower - upper) * sizeof *gl_upper);
 	memset(gl_lower, 0, sizeof *gl_lower);
 
+	/* Every line from the new history line down has moved. */
+	for (yy = gd->hsize; yy <= gd->hsize + gd->sy; yy++)
+		grid_changed(gd, yy);
+
 	/* Move the history offset down over the line. */
 	gd->hsize++;
+	grid_index_update(gd);
+}
+
+/* Remove all the history. */
+void
+grid_clear_history(struct grid *gd)
+{
+	GRID_DEBUG(gd, "");
+
+	grid_index_remove(gd, gd->hsize);
+	grid_move_lines(gd, 0, gd->hsize, gd->sy);
+	gd->hremoved += gd->hsize;
+	gd->hsize = 0;
 }
 
 /* Expand line to fit to cell. */
@@ -267,6 +301,7 @@ grid_get_cell(struct grid *gd, u_int px, u_int py)
 		return (NULL);
 
 	grid_expand_line(gd, py, px + 1);
+	grid_changed(gd, py);
 	return (&gd->linedata[py].celldata[px]);
 }
 
@@ -280,6 +315,7 @@ grid_set_cell(
 
 	grid_expand_line(gd, py, px + 1);
 	grid_put_cell(gd, px, py, gc);
+	grid_changed(gd, py);
 }
 
 /* Get UTF-8 for reading. */
@@ -302,6 +338,7 @@ grid_get_utf8(struct grid *gd, u_int px, u_int py)
 		return (NULL);
 
 	grid_expand_line_utf8(gd, py, px + 1);
+	grid_changed(gd, py);
 	return (&gd->linedata[py].utf8data[px]);
 }
 
@@ -315,6 +352,7 @@ grid_set_utf8(
 
 	grid_expand_line_utf8(gd, py, px + 1);
 	grid_put_utf8(gd, px, py, gc);
+	grid_changed(gd, py);
 }
 
 /* Clear area. */
@@ -341,6 +379,7 @@ grid_clear(struct grid *gd, u_int px, u_int py, u_int nx, u_int ny)
 	for (yy = py; yy < py + ny; yy++) {
 		if (px >= gd->linedata[yy].cellsize)
 			continue;
+		grid_changed(gd, yy);
 		if (px + nx >= gd->linedata[yy].cellsize) {
 			gd->linedata[yy].cellsize = px;
 			continue;
@@ -375,6 +414,7 @@ grid_clear_lines(struct grid *gd, u_int py, u_int ny)
 		free(gl->celldata);
 		free(gl->utf8data);
 		memset(gl, 0, sizeof *gl);
+		grid_changed(gd, yy);
 	}
 }
 
@@ -408,11 +448,15 @@ grid_move_lines(struct grid *gd, u_int dy, u_int py, u_int ny)
 	memmove(
 	    &gd->linedata[dy], &gd->linedata[py], ny * (sizeof *gd->linedata));
 
+	for (yy = dy; yy < dy + ny; yy++)
+		grid_changed(gd, yy);
+
 	/* Wipe any lines that have been moved (without freeing them). */
 	for (yy = py; yy < py + ny; yy++) {
 		if (yy >= dy && yy < dy + ny)
 			continue;
 		memset(&gd->linedata[yy], 0, sizeof gd->linedata[yy]);
+		grid_changed(gd, yy);
 	}
 }
 
@@ -434,6 +478,7 @@ grid_move_cells(struct grid *gd, u_int dx, u_int px, u_int py, u_int nx)
 
 	grid_expand_line(gd, py, px + nx);
 	grid_expand_line(gd, py, dx + nx);
+	grid_changed(gd, py);
 	memmove(
 	    &gl->celldata[dx], &gl->celldata[px], nx * sizeof *gl->celldata);
 
@@ -499,6 +544,143 @@ grid_string_cells(struct grid *gd, u_int px, u_int py, u_int nx)
 	return (buf);
 }
 
+/*
+ * Append a line to a buffer without trailing spaces. If lastgc is not NULL,
+ * escape sequences are added for changes in attributes and colours from
+ * lastgc, which is updated as cells are written.
+ */
+void
+grid_string_line(struct grid *gd, u_int py, u_int nx, struct evbuffer *evb,
+    struct grid_cell *lastgc)
+{
+	const struct grid_line	*gl;
+	const struct grid_cell	*gc;
+	const struct grid_utf8	*gu;
+	u_int			 xx, end;
+
+	GRID_DEBUG(gd, "py=%u, nx=%u", py, nx);
+
+	if (grid_check_y(gd, py) != 0)
+		return;
+	gl = &gd->linedata[py];
+
+	end = gl->cellsize;
+	if (end > nx)
+		end = nx;
+	while (end > 0) {
+		gc = &gl->celldata[end - 1];
+		if (gc->flags & GRID_FLAG_UTF8 || gc->data != ' ')
+			break;
+		if (lastgc != NULL && (gc->attr != 0 || gc->bg != 8 ||
+		    gc->flags & GRID_FLAG_BG256))
+			break;
+		end--;
+	}
+
+	for (xx = 0; xx < end; xx++) {
+		gc = &gl->celldata[xx];
+		if (gc->flags & GRID_FLAG_PADDING)
+			continue;
+		if (lastgc != NULL)
+			grid_string_code(gc, lastgc, evb);
+
+		if (gc->flags & GRID_FLAG_UTF8) {
+			gu = &gl->utf8data[xx];
+			evbuffer_add(evb, gu->data, grid_utf8_size(gu));
+		} else
+			evbuffer_add(evb, &gc->data, 1);
+	}
+}
+
+/*
+ * Add the escape sequences needed to change from the attributes and colours
+ * of lastgc to those of gc, and update lastgc.
+ */
+void
+grid_string_code(const struct grid_cell *gc, struct grid_cell *lastgc,
+    struct evbuffer *evb)
+{
+	static const struct {
+		u_char	mask;
+		u_int	code;
+	} attrs[] = {
+		{ GRID_ATTR_BRIGHT, 1 },
+		{ GRID_ATTR_DIM, 2 },
+		{ GRID_ATTR_ITALICS, 3 },
+		{ GRID_ATTR_UNDERSCORE, 4 },
+		{ GRID_ATTR_BLINK, 5 },
+		{ GRID_ATTR_REVERSE, 7 },
+		{ GRID_ATTR_HIDDEN, 8 },
+	};
+	char	buf[64];
+	size_t	off;
+	u_int	i, code;
+	u_char	flags;
+
+	flags = gc->flags & (GRID_FLAG_FG256|GRID_FLAG_BG256);
+	off = 0;
+
+	/* There is no way to turn off one attribute, so reset them all. */
+	if (lastgc->attr & ~gc->attr & ~GRID_ATTR_CHARSET) {
+		off += xsnprintf(buf + off, sizeof buf - off, "0;");
+		lastgc->attr &= GRID_ATTR_CHARSET;
+		lastgc->flags &= ~(GRID_FLAG_FG256|GRID_FLAG_BG256);
+		lastgc->fg = 8;
+		lastgc->bg = 8;
+	}
+	for (i = 0; i < nitems(attrs); i++) {
+		if ((gc->attr & attrs[i].mask) &&
+		    !(lastgc->attr & attrs[i].mask)) {
+			off += xsnprintf(buf + off, sizeof buf - off, "%u;",
+			    attrs[i].code);
+		}
+	}
+
+	if (gc->fg != lastgc->fg ||
+	    (flags & GRID_FLAG_FG256) != (lastgc->flags & GRID_FLAG_FG256)) {
+		if (flags & GRID_FLAG_FG256) {
+			off += xsnprintf(buf + off, sizeof buf - off,
+			    "38;5;%u;", gc->fg);
+		} else {
+			code = gc->fg;
+			if (code < 8)
+				code += 30;
+			else if (code == 8)
+				code = 39;
+			off += xsnprintf(buf + off, sizeof buf - off, "%u;", code);
+		}
+	}
+	if (gc->bg != lastgc->bg ||
+	    (flags & GRID_FLAG_BG256) != (lastgc->flags & GRID_FLAG_BG256)) {
+		if (flags & GRID_FLAG_BG256) {
+			off += xsnprintf(buf + off, sizeof buf - off,
+			    "48;5;%u;", gc->bg);
+		} else {
+			code = gc->bg;
+			if (code < 8)
+				code += 40;
+			else if (code == 8)
+				code = 49;
+			off += xsnprintf(buf + off, sizeof buf - off, "%u;", code);
+		}
+	}
+	if (off != 0)
+		evbuffer_add_printf(evb, "\033[%.*sm", (int) off - 1, buf);
+
+	if ((gc->attr ^ lastgc->attr) & GRID_ATTR_CHARSET) {
+		if (gc->attr & GRID_ATTR_CHARSET)
+			evbuffer_add(evb, "\016", 1);
+		else
+			evbuffer_add(evb, "\017", 1);
+	}
+
+	lastgc->attr = gc->attr;
+	lastgc->flags = (lastgc->flags & ~(GRID_FLAG_FG256|GRID_FLAG_BG256)) |
+	    flags;
+	lastgc->fg = gc->fg;
+	lastgc->bg = gc->bg;
+}
+
 /*
  * Duplicate a set of lines between two grids. If there aren't enough lines in
  * either source or destination, the number of lines is limited to the number
@@ -536,6 +718,7 @@ grid_duplicate_lines(
 			memcpy(dstl->utf8data, srcl->utf8data,
 			    srcl->utf8size * sizeof *dstl->utf8data);
 		}
+		grid_changed(dst, dy);
 
 		sy++;
 		dy++;
@@ -726,17 +726,36 @@ input_set_state(struct window_pane *wp, const struct input_transition *itr)
 		ictx->state->enter(ictx);
 }
 
-/* Parse input. */
-void
+/* Parse input. Returns 1 if some was left because of input-limit. */
+int
 input_parse(struct window_pane *wp)
+{
+	struct evbuffer	*evb = wp->event->input;
+	size_t		 len, limit;
+
+	if (EVBUFFER_LENGTH(evb) == 0)
+		return (0);
+
+	/* Only parse up to the limit, the rest is left for next time. */
+	len = EVBUFFER_LENGTH(evb);
+	limit = options_get_number(&wp->window->options, "input-limit");
+	if (limit != 0 && len > limit)
+		len = limit;
+	input_parse_buffer(wp, EVBUFFER_DATA(evb), len);
+
+	evbuffer_drain(evb, len);
+	return (EVBUFFER_LENGTH(evb) != 0);
+}
+
+/* Parse a buffer of input as if it had been read from the pane. */
+void
+input_parse_buffer(struct window_pane *wp, u_char *buf, size_t len)
 {
 	struct input_ctx		*ictx = &wp->ictx;
 	const struct input_transition	*itr;
-	struct evbuffer			*evb = wp->event->input;
-	u_char				*buf;
-	size_t				 len, off;
+	size_t				 off;
 
-	if (EVBUFFER_LENGTH(evb) == 0)
+	if (len == 0)
 		return;
 
 	wp->window->flags |= WINDOW_ACTIVITY;
@@ -752,9 +771,8 @@ input_parse(struct window_pane *wp)
 		screen_write_start(&ictx->ctx, NULL, &wp->base);
 	ictx->wp = wp;
 
-	buf = EVBUFFER_DATA(evb);
-	len = EVBUFFER_LENGTH(evb);
-	notify_input(wp, evb);
+	notify_input(wp, buf, len);
+	global_stats.input_bytes += len;
 	off = 0;
 
 	/* Parse the input. */
@@ -792,8 +810,6 @@ input_parse(struct window_pane *wp)
 
 	/* Close the screen. */
 	screen_write_stop(&ictx->ctx);
-
-	evbuffer_drain(evb, len);
 }
 
 /* Split the parameter list (if any). */
@@ -881,6 +897,7 @@ input_print(struct input_ctx *ictx)
 {
 	ictx->cell.data = ictx->ch;
 	screen_write_cell(&ictx->ctx, &ictx->cell, NULL);
+	global_stats.input_cells++;
 
 	return (0);
 }
@@ -1660,6 +1677,7 @@ input_utf8_close(struct input_ctx *ictx)
 	ictx->cell.flags |= GRID_FLAG_UTF8;
 	screen_write_cell(&ictx->ctx, &ictx->cell, &ictx->utf8data);
 	ictx->cell.flags &= ~GRID_FLAG_UTF8;
+	global_stats.input_cells++;
 
 	return (0);
 }
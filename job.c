@@ -32,6 +32,7 @@
  */
 
 void	job_callback(struct bufferevent *, short, void *);
+void	job_done(struct job *);
 
 /* All jobs list. */
 struct joblist	all_jobs = LIST_HEAD_INITIALIZER(all_jobs);
@@ -43,52 +44,52 @@ job_run(const char *cmd,
 {
 	struct job	*job;
 	struct environ	 env;
+	struct spawn	 sp;
+	char		*argv[4];
 	pid_t		 pid;
 	int		 nullfd, out[2];
 
 	if (socketpair(AF_UNIX, SOCK_STREAM, PF_UNSPEC, out) != 0)
 		return (NULL);
+	if ((nullfd = open(_PATH_DEVNULL, O_RDWR, 0)) == -1) {
+		close(out[0]);
+		close(out[1]);
+		return (NULL);
+	}
 
 	environ_init(&env);
 	environ_copy(&global_environ, &env);
 	server_fill_environ(NULL, &env);
 
-	switch (pid = fork()) {
-	case -1:
-		environ_free(&env);
-		return (NULL);
-	case 0:		/* child */
-		clear_signals(1);
-
-		environ_push(&env);
-		environ_free(&env);
+	argv[0] = xstrdup("sh");
+	argv[1] = xstrdup("-c");
+	argv[2] = xstrdup(cmd);
+	argv[3] = NULL;
 
-		if (dup2(out[1], STDOUT_FILENO) == -1)
-			fatal("dup2 failed");
-		if (out[1] != STDOUT_FILENO)
-			close(out[1]);
-		close(out[0]);
-
-		nullfd = open(_PATH_DEVNULL, O_RDWR, 0);
-		if (nullfd < 0)
-			fatal("open failed");
-		if (dup2(nullfd, STDIN_FILENO) == -1)
-			fatal("dup2 failed");
-		if (dup2(nullfd, STDERR_FILENO) == -1)
-			fatal("dup2 failed");
-		if (nullfd != STDIN_FILENO && nullfd != STDERR_FILENO)
-			close(nullfd);
+	memset(&sp, 0, sizeof sp);
+	sp.path = _PATH_BSHELL;
+	sp.argv = argv;
+	sp.envp = environ_array(&env);
+	sp.fds[0] = nullfd;
+	sp.fds[1] = out[1];
+	sp.fds[2] = nullfd;
 
-		closefrom(STDERR_FILENO + 1);
+	pid = spawn_process(&sp);
 
-		execl(_PATH_BSHELL, "sh", "-c", cmd, (char *) NULL);
-		fatal("execl failed");
-	}
-
-	/* parent */
+	environ_free_array(sp.envp);
 	environ_free(&env);
+	free(argv[0]);
+	free(argv[1]);
+	free(argv[2]);
+	close(nullfd);
 	close(out[1]);
 
+	if (pid == -1) {
+		close(out[0]);
+		return (NULL);
+	}
+	global_stats.job_forks++;
+
 	job = xmalloc(sizeof *job);
 	job->cmd = xstrdup(cmd);
 	job->pid = pid;
@@ -104,6 +105,7 @@ job_run(const char *cmd,
 	setblocking(job->fd, 0);
 
 	job->event = bufferevent_new(job->fd, NULL, NULL, job_callback, job);
+	bufferevent_priority_set(job->event, EVENT_PRIORITY_OUTPUT);
 	bufferevent_enable(job->event, EV_READ);
 
 	log_debug("run job %p: %s, pid %ld", job, job->cmd, (long) job->pid);
@@ -142,8 +144,7 @@ job_callback(unused struct bufferevent *bufev, unused short events, void *data)
 	log_debug("job error %p: %s, pid %ld", job, job->cmd, (long) job->pid);
 
 	if (job->pid == -1) {
-		if (job->callbackfn != NULL)
-			job->callbackfn(job);
+		job_done(job);
 		job_free(job);
 	} else {
 		bufferevent_disable(job->event, EV_READ);
@@ -152,6 +153,20 @@ job_callback(unused struct bufferevent *bufev, unused short events, void *data)
 	}
 }
 
+/* Job has exited and all its output has been read, fire the callback. */
+void
+job_done(struct job *job)
+{
+	struct timeval	tv;
+
+	if (job->callbackfn == NULL)
+		return;
+
+	stats_start(&tv);
+	job->callbackfn(job);
+	stats_stop(STATS_JOB, &tv);
+}
+
 /* Job died (waitpid() returned its pid). */
 void
 job_died(struct job *job, int status)
@@ -161,8 +176,7 @@ job_died(struct job *job, int status)
 	job->status = status;
 
 	if (job->fd == -1) {
-		if (job->callbackfn != NULL)
-			job->callbackfn(job);
+		job_done(job);
 		job_free(job);
 	} else
 		job->pid = -1;
@@ -0,0 +1,106 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Nicholas Marriott <nicm@users.sourceforge.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/types.h>
+#include <sys/time.h>
+
+#include "tmux.h"
+
+/*
+ * Latency histograms. Times are kept in microseconds in buckets which are a
+ * quarter of a power of two wide, so percentiles are accurate to within 25%
+ * without keeping every sample.
+ */
+
+u_int	latency_bucket(u_int);
+u_int	latency_bucket_limit(u_int);
+
+/* Find the bucket for a time. */
+u_int
+latency_bucket(u_int us)
+{
+	u_int	bit, idx;
+
+	if (us < 4)
+		return (us);
+
+	for (bit = 2; bit < 31 && (us >> (bit + 1)) != 0; bit++)
+		/* nothing */;
+	idx = (bit - 1) * 4 + ((us >> (bit - 2)) & 3);
+	if (idx >= LATENCY_BUCKETS)
+		idx = LATENCY_BUCKETS - 1;
+	return (idx);
+}
+
+/* Get the upper limit of a bucket. */
+u_int
+latency_bucket_limit(u_int idx)
+{
+	u_int	bit;
+
+	if (idx < 4)
+		return (idx + 1);
+	bit = idx / 4 + 1;
+	return ((4 + idx % 4 + 1) << (bit - 2));
+}
+
+/* Add the time since start to a histogram. */
+void
+latency_add(struct latency *lat, struct timeval *start, struct timeval *now)
+{
+	struct timeval	tv;
+	u_int		us;
+
+	timersub(now, start, &tv);
+	if (tv.tv_sec < 0)
+		return;
+	if (tv.tv_sec > LATENCY_MAXIMUM)
+		us = LATENCY_MAXIMUM * 1000000;
+	else
+		us = tv.tv_sec * 1000000 + tv.tv_usec;
+
+	lat->buckets[latency_bucket(us)]++;
+	lat->count++;
+	if (us > lat->maximum)
+		lat->maximum = us;
+}
+
+/* Get a percentile from a histogram, in microseconds. */
+u_int
+latency_percentile(struct latency *lat, u_int pct)
+{
+	u_int	idx, want, seen, limit;
+
+	if (lat->count == 0)
+		return (0);
+
+	want = ((unsigned long long) lat->count * pct + 99) / 100;
+	if (want == 0)
+		want = 1;
+
+	seen = 0;
+	for (idx = 0; idx < LATENCY_BUCKETS; idx++) {
+		seen += lat->buckets[idx];
+		if (seen >= want)
+			break;
+	}
+	limit = latency_bucket_limit(idx);
+	if (limit > lat->maximum)
+		return (lat->maximum);
+	return (limit);
+}
@@ -171,6 +171,7 @@ layout_fix_panes(struct window *w, u_int wsx, u_int wsy)
 	struct layout_cell	*lc;
 	u_int			 sx, sy;
 
+	screen_redraw_invalidate(w);
 	TAILQ_FOREACH(wp, &w->panes, entry) {
 		if ((lc = wp->layout_cell) == NULL)
 			continue;
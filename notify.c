@@ -68,6 +68,17 @@ notify_add(enum notify_type type, struct client *c, struct session *s,
 {
 	struct notify_entry	*ne;
 
+	/*
+	 * A layout change notification gives the layout when it is sent, so if
+	 * one for this window is already waiting, there is no need for another.
+	 */
+	if (type == NOTIFY_WINDOW_LAYOUT_CHANGED) {
+		TAILQ_FOREACH(ne, &notify_queue, entry) {
+			if (ne->type == type && ne->window == w)
+				return;
+		}
+	}
+
 	ne = xcalloc(1, sizeof *ne);
 	ne->type = type;
 	ne->client = c;
@@ -132,9 +143,10 @@ notify_drain(void)
 }
 
 void
-notify_input(struct window_pane *wp, struct evbuffer *input)
+notify_input(struct window_pane *wp, u_char *buf, size_t len)
 {
 	struct client	*c;
+	struct evbuffer	*encoded[2];
 	u_int		 i;
 
 	/*
@@ -144,10 +156,16 @@ notify_input(struct window_pane *wp, struct evbuffer *input)
 	if (!notify_enabled)
 		return;
 
+	/* The output is encoded once for all clients using each encoding. */
+	encoded[0] = encoded[1] = NULL;
 	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
 		c = ARRAY_ITEM(&clients, i);
 		if (c != NULL && (c->flags & CLIENT_CONTROL))
-			control_notify_input(c, wp, input);
+			control_notify_input(c, wp, buf, len, encoded);
+	}
+	for (i = 0; i < nitems(encoded); i++) {
+		if (encoded[i] != NULL)
+			evbuffer_free(encoded[i]);
 	}
 }
 
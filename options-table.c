@@ -53,6 +53,9 @@ const char *options_table_status_position_list[] = {
 const char *options_table_bell_action_list[] = {
 	"none", "any", "current", NULL
 };
+const char *options_table_pipe_pane_policy_list[] = {
+	"drop-oldest", "drop-newest", "pause", NULL
+};
 
 /* Server options. */
 const struct options_table_entry server_options_table[] = {
@@ -63,6 +66,13 @@ const struct options_table_entry server_options_table[] = {
 	  .default_num = 20
 	},
 
+	{ .name = "control-output-limit",
+	  .type = OPTIONS_TABLE_NUMBER,
+	  .minimum = 0,
+	  .maximum = INT_MAX,
+	  .default_num = 1048576
+	},
+
 	{ .name = "escape-time",
 	  .type = OPTIONS_TABLE_NUMBER,
 	  .minimum = 0,
@@ -85,6 +95,18 @@ const struct options_table_entry server_options_table[] = {
 	  .default_num = 1
 	},
 
+	{ .name = "stats-file",
+	  .type = OPTIONS_TABLE_STRING,
+	  .default_str = ""
+	},
+
+	{ .name = "stats-interval",
+	  .type = OPTIONS_TABLE_NUMBER,
+	  .minimum = 1,
+	  .maximum = INT_MAX,
+	  .default_num = 60
+	},
+
 	{ .name = NULL }
 };
 
@@ -516,6 +538,13 @@ const struct options_table_entry window_options_table[] = {
 	  .default_num = 0
 	},
 
+	{ .name = "input-limit",
+	  .type = OPTIONS_TABLE_NUMBER,
+	  .minimum = 0,
+	  .maximum = INT_MAX,
+	  .default_num = 4096
+	},
+
 	{ .name = "main-pane-height",
 	  .type = OPTIONS_TABLE_NUMBER,
 	  .minimum = 1,
@@ -595,11 +624,36 @@ const struct options_table_entry window_options_table[] = {
 	  .default_num = 0
 	},
 
+	{ .name = "pipe-pane-limit",
+	  .type = OPTIONS_TABLE_NUMBER,
+	  .minimum = 0,
+	  .maximum = INT_MAX,
+	  .default_num = 1048576
+	},
+
+	{ .name = "pipe-pane-policy",
+	  .type = OPTIONS_TABLE_CHOICE,
+	  .choices = options_table_pipe_pane_policy_list,
+	  .default_num = PIPE_PANE_PAUSE
+	},
+
+	{ .name = "regex-search",
+	  .type = OPTIONS_TABLE_FLAG,
+	  .default_num = 0
+	},
+
 	{ .name = "remain-on-exit",
 	  .type = OPTIONS_TABLE_FLAG,
 	  .default_num = 0
 	},
 
+	{ .name = "search-index",
+	  .type = OPTIONS_TABLE_NUMBER,
+	  .minimum = 0,
+	  .maximum = INT_MAX,
+	  .default_num = 0
+	},
+
 	{ .name = "synchronize-panes",
 	  .type = OPTIONS_TABLE_FLAG,
 	  .default_num = 0
@@ -0,0 +1,303 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Nicholas Marriott <nicm@users.sourceforge.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/types.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tmux.h"
+
+/*
+ * Pipes from panes to commands. A pane may have any number of pipes, each
+ * with a name. Output which cannot be written to a pipe straight away is kept
+ * in reference counted chunks shared between the pipes, each pipe keeping a
+ * list of the parts of chunks it still has to write.
+ *
+ * When more than pipe-pane-limit bytes are waiting for a pipe, its policy
+ * decides whether the oldest or newest output is dropped or reading from the
+ * pane stops until the pipe has caught up.
+ */
+
+void	pipe_callback(int, short, void *);
+void	pipe_add(struct pane_pipe *, struct pipe_chunk *, size_t, size_t);
+void	pipe_drop(struct pane_pipe *, size_t);
+void	pipe_remove(struct pane_pipe *, struct pipe_ref *);
+void	pipe_resume(struct window_pane *);
+
+/* Find a pipe by name. */
+struct pane_pipe *
+pipe_find(struct window_pane *wp, const char *name)
+{
+	struct pane_pipe	*pp;
+
+	TAILQ_FOREACH(pp, &wp->pipes, entry) {
+		if (strcmp(pp->name, name) == 0)
+			return (pp);
+	}
+	return (NULL);
+}
+
+/* Add a pipe on fd, which is made nonblocking. */
+struct pane_pipe *
+pipe_open(struct window_pane *wp, const char *name, const char *cmd, int fd,
+    int policy)
+{
+	struct pane_pipe	*pp;
+
+	if (TAILQ_EMPTY(&wp->pipes))
+		wp->pipe_off = EVBUFFER_LENGTH(wp->event->input);
+
+	pp = xcalloc(1, sizeof *pp);
+	pp->name = xstrdup(name);
+	pp->cmd = xstrdup(cmd);
+	pp->wp = wp;
+	pp->policy = policy;
+	TAILQ_INIT(&pp->refs);
+
+	pp->fd = fd;
+	setblocking(fd, 0);
+	event_set(&pp->event, fd, EV_WRITE, pipe_callback, pp);
+	event_priority_set(&pp->event, EVENT_PRIORITY_OUTPUT);
+
+	TAILQ_INSERT_TAIL(&wp->pipes, pp, entry);
+	return (pp);
+}
+
+/* Close a pipe, dropping anything still waiting. */
+void
+pipe_close(struct pane_pipe *pp)
+{
+	struct window_pane	*wp = pp->wp;
+
+	while (!TAILQ_EMPTY(&pp->refs))
+		pipe_remove(pp, TAILQ_FIRST(&pp->refs));
+
+	event_del(&pp->event);
+	close(pp->fd);
+
+	TAILQ_REMOVE(&wp->pipes, pp, entry);
+	free(pp->name);
+	free(pp->cmd);
+	free(pp);
+
+	pipe_resume(wp);
+}
+
+/* Close all of a pane's pipes. */
+void
+pipe_close_all(struct window_pane *wp)
+{
+	while (!TAILQ_EMPTY(&wp->pipes))
+		pipe_close(TAILQ_FIRST(&wp->pipes));
+}
+
+/* Total bytes dropped by all of a pane's pipes. */
+unsigned long long
+pipe_dropped(struct window_pane *wp)
+{
+	struct pane_pipe	*pp;
+	unsigned long long	 dropped;
+
+	dropped = 0;
+	TAILQ_FOREACH(pp, &wp->pipes, entry)
+		dropped += pp->dropped;
+	return (dropped);
+}
+
+/*
+ * Write new output to each pipe. If nothing is waiting, try writing straight
+ * to the pipe; anything left is copied into a chunk once however many pipes
+ * need it.
+ */
+void
+pipe_write(struct window_pane *wp, u_char *data, size_t size)
+{
+	struct pane_pipe	*pp, *pp1;
+	struct pipe_chunk	*chunk;
+	size_t			 off, keep, limit, excess;
+	ssize_t			 n;
+
+	limit = options_get_number(&wp->window->options, "pipe-pane-limit");
+	chunk = NULL;
+
+	TAILQ_FOREACH_SAFE(pp, &wp->pipes, entry, pp1) {
+		off = 0;
+		if (pp->waiting == 0) {
+			n = write(pp->fd, data, size);
+			if (n == -1 && errno != EAGAIN && errno != EINTR) {
+				pipe_close(pp);
+				continue;
+			}
+			if (n > 0)
+				off = n;
+			if (off == size)
+				continue;
+		}
+
+		/* Apply the policy if this puts the pipe over the limit. */
+		keep = size - off;
+		if (limit != 0 && pp->waiting + keep > limit) {
+			excess = pp->waiting + keep - limit;
+			switch (pp->policy) {
+			case PIPE_PANE_DROP_OLDEST:
+				if (excess > pp->waiting) {
+					pp->dropped += excess - pp->waiting;
+					off += excess - pp->waiting;
+					keep -= excess - pp->waiting;
+					excess = pp->waiting;
+				}
+				pipe_drop(pp, excess);
+				break;
+			case PIPE_PANE_DROP_NEWEST:
+				if (excess > keep)
+					excess = keep;
+				pp->dropped += excess;
+				keep -= excess;
+				break;
+			case PIPE_PANE_PAUSE:
+				pp->flags |= PIPE_PAUSED;
+				wp->flags |= PANE_PIPEPAUSE;
+				bufferevent_disable(wp->event, EV_READ);
+				break;
+			}
+		}
+		if (keep == 0)
+			continue;
+
+		if (chunk == NULL) {
+			chunk = xmalloc(sizeof *chunk);
+			chunk->data = xmalloc(size);
+			memcpy(chunk->data, data, size);
+			chunk->size = size;
+			chunk->references = 0;
+		}
+		pipe_add(pp, chunk, off, keep);
+	}
+}
+
+/* Queue part of a chunk for a pipe. */
+void
+pipe_add(struct pane_pipe *pp, struct pipe_chunk *chunk, size_t off,
+    size_t size)
+{
+	struct pipe_ref	*ref;
+
+	ref = xmalloc(sizeof *ref);
+	ref->chunk = chunk;
+	ref->off = off;
+	ref->size = size;
+	chunk->references++;
+
+	TAILQ_INSERT_TAIL(&pp->refs, ref, entry);
+	pp->waiting += size;
+
+	if (!event_pending(&pp->event, EV_WRITE, NULL))
+		event_add(&pp->event, NULL);
+}
+
+/* Drop the oldest output waiting for a pipe. */
+void
+pipe_drop(struct pane_pipe *pp, size_t size)
+{
+	struct pipe_ref	*ref;
+
+	pp->dropped += size;
+	while (size != 0 && (ref = TAILQ_FIRST(&pp->refs)) != NULL) {
+		if (ref->size > size) {
+			ref->off += size;
+			ref->size -= size;
+			pp->waiting -= size;
+			break;
+		}
+		size -= ref->size;
+		pipe_remove(pp, ref);
+	}
+}
+
+/* Remove a reference, freeing the chunk if it was the last. */
+void
+pipe_remove(struct pane_pipe *pp, struct pipe_ref *ref)
+{
+	struct pipe_chunk	*chunk = ref->chunk;
+
+	pp->waiting -= ref->size;
+	TAILQ_REMOVE(&pp->refs, ref, entry);
+	free(ref);
+
+	if (--chunk->references == 0) {
+		free(chunk->data);
+		free(chunk);
+	}
+}
+
+/* Write as much waiting output as possible. */
+/* ARGSUSED */
+void
+pipe_callback(int fd, unused short events, void *data)
+{
+	struct pane_pipe	*pp = data;
+	struct pipe_ref		*ref;
+	ssize_t			 n;
+
+	while ((ref = TAILQ_FIRST(&pp->refs)) != NULL) {
+		n = write(fd, ref->chunk->data + ref->off, ref->size);
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN)
+				break;
+			pipe_close(pp);
+			return;
+		}
+		if ((size_t) n != ref->size) {
+			ref->off += n;
+			ref->size -= n;
+			pp->waiting -= n;
+			break;
+		}
+		pipe_remove(pp, ref);
+	}
+
+	if (pp->waiting != 0) {
+		event_add(&pp->event, NULL);
+		return;
+	}
+	if (pp->flags & PIPE_PAUSED) {
+		pp->flags &= ~PIPE_PAUSED;
+		pipe_resume(pp->wp);
+	}
+}
+
+/* Start reading from the pane again if no pipes are still catching up. */
+void
+pipe_resume(struct window_pane *wp)
+{
+	struct pane_pipe	*pp;
+
+	if (!(wp->flags & PANE_PIPEPAUSE))
+		return;
+	TAILQ_FOREACH(pp, &wp->pipes, entry) {
+		if (pp->flags & PIPE_PAUSED)
+			return;
+	}
+	wp->flags &= ~PANE_PIPEPAUSE;
+	window_pane_update_read(wp);
+}
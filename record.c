@@ -0,0 +1,403 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Nicholas Marriott <nicm@users.sourceforge.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tmux.h"
+
+/*
+ * Pane recordings and replay.
+ *
+ * A recording holds everything read from a pane's pty and when, and the size
+ * of the pane whenever it changes. It starts with RECORD_MAGIC followed by a
+ * list of records, each a type byte, the time in milliseconds since the
+ * recording started and the length of the data (both four bytes, most
+ * significant first) and then the data itself. Size records have eight bytes
+ * of data: the width and height in the same form.
+ *
+ * Records are built up in memory and written when there is RECORD_FLUSH of
+ * them or once a second, so recording costs little more than a copy. The file
+ * is not blocking: whatever cannot be written straight away is written when
+ * the file is ready, and if more than RECORD_MAXIMUM builds up because it is
+ * never ready the recording is stopped.
+ */
+
+/* Write when this much is waiting. */
+#define RECORD_FLUSH 65536
+
+/* Give up if this much is waiting. */
+#define RECORD_MAXIMUM (16 * 1024 * 1024)
+
+struct record {
+	int		 fd;
+	struct evbuffer	*buffer;
+	struct timeval	 start;
+	struct event	 timer;
+	struct event	 event;
+};
+
+struct replay {
+	u_char		*buf;
+	size_t		 len;
+	size_t		 off;
+
+	int		 flags;
+	struct timeval	 start;
+	struct event	 timer;
+};
+
+void	record_put32(u_char *, u_int);
+u_int	record_get32(const u_char *);
+void	record_add(struct window_pane *, enum record_type, const u_char *,
+	    size_t);
+int	record_flush(struct record *);
+void	record_timer(int, short, void *);
+void	record_write_callback(int, short, void *);
+u_int	replay_elapsed(struct replay *);
+void	replay_callback(int, short, void *);
+
+void
+record_put32(u_char *ptr, u_int n)
+{
+	ptr[0] = n >> 24;
+	ptr[1] = n >> 16;
+	ptr[2] = n >> 8;
+	ptr[3] = n;
+}
+
+u_int
+record_get32(const u_char *ptr)
+{
+	return ((ptr[0] << 24) | (ptr[1] << 16) | (ptr[2] << 8) | ptr[3]);
+}
+
+/* Start recording a pane to a file. */
+int
+record_start(struct window_pane *wp, const char *path, char **cause)
+{
+	struct record	*rec;
+	mode_t		 mask;
+	int		 fd;
+
+	mask = umask(S_IRWXG | S_IRWXO);
+	fd = open(path, O_WRONLY|O_CREAT|O_TRUNC|O_NONBLOCK, 0666);
+	umask(mask);
+	if (fd == -1) {
+		xasprintf(cause, "%s: %s", path, strerror(errno));
+		return (-1);
+	}
+
+	record_stop(wp);
+
+	rec = xcalloc(1, sizeof *rec);
+	rec->fd = fd;
+	rec->buffer = evbuffer_new();
+	if (gettimeofday(&rec->start, NULL) != 0)
+		fatal("gettimeofday failed");
+	evtimer_set(&rec->timer, record_timer, wp);
+	event_set(&rec->event, fd, EV_WRITE, record_write_callback, wp);
+	wp->record = rec;
+
+	evbuffer_add(rec->buffer, RECORD_MAGIC, RECORD_MAGICLEN);
+	record_resize(wp);
+	return (0);
+}
+
+/* Write out whatever can be written now and stop recording. */
+void
+record_stop(struct window_pane *wp)
+{
+	struct record	*rec = wp->record;
+
+	if (rec == NULL)
+		return;
+
+	if (record_flush(rec) == 0 && EVBUFFER_LENGTH(rec->buffer) != 0) {
+		log_debug("record dropped %zu bytes",
+		    (size_t) EVBUFFER_LENGTH(rec->buffer));
+	}
+	event_del(&rec->event);
+	evtimer_del(&rec->timer);
+	evbuffer_free(rec->buffer);
+	close(rec->fd);
+	free(rec);
+
+	wp->record = NULL;
+}
+
+/* Record data read from the pane. */
+void
+record_data(struct window_pane *wp, const u_char *buf, size_t len)
+{
+	if (len != 0)
+		record_add(wp, RECORD_DATA, buf, len);
+}
+
+/* Record the current size of the pane. */
+void
+record_resize(struct window_pane *wp)
+{
+	u_char	data[8];
+
+	record_put32(data, wp->sx);
+	record_put32(data + 4, wp->sy);
+	record_add(wp, RECORD_SIZE, data, sizeof data);
+}
+
+/* Add a record to the buffer, writing it if it is getting large. */
+void
+record_add(struct window_pane *wp, enum record_type type, const u_char *data,
+    size_t size)
+{
+	struct record	*rec = wp->record;
+	struct timeval	 tv;
+	u_char		 hdr[RECORD_HEADERLEN];
+
+	if (gettimeofday(&tv, NULL) != 0)
+		fatal("gettimeofday failed");
+	timersub(&tv, &rec->start, &tv);
+
+	hdr[0] = type;
+	record_put32(hdr + 1, tv.tv_sec * 1000 + tv.tv_usec / 1000);
+	record_put32(hdr + 5, size);
+	evbuffer_add(rec->buffer, hdr, sizeof hdr);
+	evbuffer_add(rec->buffer, data, size);
+
+	if (EVBUFFER_LENGTH(rec->buffer) >= RECORD_MAXIMUM) {
+		log_debug("record too far behind");
+		record_stop(wp);
+	} else if (EVBUFFER_LENGTH(rec->buffer) >= RECORD_FLUSH) {
+		if (record_flush(rec) != 0)
+			record_stop(wp);
+	} else if (!evtimer_pending(&rec->timer, NULL)) {
+		tv.tv_sec = 1;
+		tv.tv_usec = 0;
+		evtimer_add(&rec->timer, &tv);
+	}
+}
+
+/*
+ * Write as much of the buffer as the file will take. If it will not take it
+ * all, carry on when it is ready.
+ */
+int
+record_flush(struct record *rec)
+{
+	while (EVBUFFER_LENGTH(rec->buffer) != 0) {
+		if (evbuffer_write(rec->buffer, rec->fd) == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN) {
+				if (!event_pending(&rec->event, EV_WRITE, NULL))
+					event_add(&rec->event, NULL);
+				break;
+			}
+			log_debug("record write failed: %s", strerror(errno));
+			return (-1);
+		}
+	}
+	return (0);
+}
+
+/* ARGSUSED */
+void
+record_write_callback(unused int fd, unused short events, void *data)
+{
+	struct window_pane	*wp = data;
+
+	if (record_flush(wp->record) != 0)
+		record_stop(wp);
+}
+
+/* ARGSUSED */
+void
+record_timer(unused int fd, unused short events, void *data)
+{
+	struct window_pane	*wp = data;
+
+	if (record_flush(wp->record) != 0)
+		record_stop(wp);
+}
+
+/*
+ * Get the next record from a recording. Returns 1 and fills in the entry if
+ * there is one, 0 at the end or -1 if the recording is not valid.
+ */
+int
+record_next(const u_char *buf, size_t len, size_t *off,
+    struct record_entry *re)
+{
+	const u_char	*hdr;
+
+	if (*off == 0) {
+		if (len < RECORD_MAGICLEN)
+			return (-1);
+		if (memcmp(buf, RECORD_MAGIC, RECORD_MAGICLEN) != 0)
+			return (-1);
+		*off = RECORD_MAGICLEN;
+	}
+	if (*off == len)
+		return (0);
+
+	if (len - *off < RECORD_HEADERLEN)
+		return (-1);
+	hdr = buf + *off;
+	if (hdr[0] != RECORD_DATA && hdr[0] != RECORD_SIZE)
+		return (-1);
+	re->type = hdr[0];
+	re->time = record_get32(hdr + 1);
+	re->size = record_get32(hdr + 5);
+	if (re->size > len - *off - RECORD_HEADERLEN)
+		return (-1);
+	if (re->type == RECORD_SIZE && re->size != 8)
+		return (-1);
+	re->data = hdr + RECORD_HEADERLEN;
+
+	*off += RECORD_HEADERLEN + re->size;
+	return (1);
+}
+
+/* Get the width and height from a size record. */
+void
+record_get_size(struct record_entry *re, u_int *sx, u_int *sy)
+{
+	*sx = record_get32(re->data);
+	*sy = record_get32(re->data + 4);
+}
+
+/*
+ * Start replaying a recording into a pane. The buffer is freed when the replay
+ * is finished.
+ */
+int
+replay_start(struct window_pane *wp, u_char *buf, size_t len, int flags,
+    char **cause)
+{
+	struct replay		*rp;
+	struct record_entry	 re;
+	size_t			 off;
+	int			 n;
+
+	off = 0;
+	while ((n = record_next(buf, len, &off, &re)) == 1)
+		/* nothing */;
+	if (n != 0) {
+		*cause = xstrdup("not a valid recording");
+		return (-1);
+	}
+
+	replay_stop(wp);
+
+	rp = xcalloc(1, sizeof *rp);
+	rp->buf = buf;
+	rp->len = len;
+	rp->off = 0;
+	rp->flags = flags;
+	if (gettimeofday(&rp->start, NULL) != 0)
+		fatal("gettimeofday failed");
+	evtimer_set(&rp->timer, replay_callback, wp);
+	event_priority_set(&rp->timer, EVENT_PRIORITY_OUTPUT);
+	wp->replay = rp;
+
+	replay_callback(-1, 0, wp);
+	return (0);
+}
+
+/* Stop replaying. */
+void
+replay_stop(struct window_pane *wp)
+{
+	struct replay	*rp = wp->replay;
+
+	if (rp == NULL)
+		return;
+
+	evtimer_del(&rp->timer);
+	free(rp->buf);
+	free(rp);
+
+	wp->replay = NULL;
+}
+
+/* Get the time since a replay started in milliseconds. */
+u_int
+replay_elapsed(struct replay *rp)
+{
+	struct timeval	tv;
+
+	if (gettimeofday(&tv, NULL) != 0)
+		fatal("gettimeofday failed");
+	timersub(&tv, &rp->start, &tv);
+	return (tv.tv_sec * 1000 + tv.tv_usec / 1000);
+}
+
+/*
+ * Feed the pane everything that is due. At full speed this stops after
+ * input-limit bytes and carries on next loop, like reading from the pty.
+ * Size records are not replayed because the layout decides the pane size.
+ */
+/* ARGSUSED */
+void
+replay_callback(unused int fd, unused short events, void *data)
+{
+	struct window_pane	*wp = data;
+	struct replay		*rp = wp->replay;
+	struct record_entry	 re;
+	struct timeval		 tv;
+	size_t			 off, limit, done;
+	u_int			 elapsed;
+
+	limit = options_get_number(&wp->window->options, "input-limit");
+	elapsed = replay_elapsed(rp);
+
+	done = 0;
+	for (;;) {
+		off = rp->off;
+		if (record_next(rp->buf, rp->len, &off, &re) != 1) {
+			replay_stop(wp);
+			return;
+		}
+
+		if (rp->flags & REPLAY_FAST) {
+			if (limit != 0 && done >= limit)
+				break;
+		} else if (re.time > elapsed)
+			break;
+		rp->off = off;
+
+		if (re.type == RECORD_DATA) {
+			input_parse_buffer(wp, (u_char *) re.data, re.size);
+			done += re.size;
+		}
+	}
+
+	timerclear(&tv);
+	if (!(rp->flags & REPLAY_FAST)) {
+		tv.tv_sec = (re.time - elapsed) / 1000;
+		tv.tv_usec = ((re.time - elapsed) % 1000) * 1000;
+	}
+	evtimer_add(&rp->timer, &tv);
+}
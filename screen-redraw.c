@@ -18,12 +18,14 @@
 
 #include <sys/types.h>
 
+#include <stdlib.h>
 #include <string.h>
 
 #include "tmux.h"
 
 int	screen_redraw_cell_border1(struct window_pane *, u_int, u_int);
-int	screen_redraw_cell_border(struct client *, u_int, u_int);
+int	screen_redraw_cell_type(int);
+void	screen_redraw_build_borders(struct window *);
 int	screen_redraw_check_cell(struct client *, u_int, u_int);
 void	screen_redraw_draw_number(struct client *, struct window_pane *);
 
@@ -43,6 +45,11 @@ void	screen_redraw_draw_number(struct client *, struct window_pane *);
 
 #define CELL_BORDERS " xqlkmjwvtun~"
 
+/* Border map entries while building: not in any pane, inside, or on border. */
+#define BORDER_NONE 0
+#define BORDER_INSIDE 1
+#define BORDER_EDGE 2
+
 /* Check if cell is on the border of a particular pane. */
 int
 screen_redraw_cell_border1(struct window_pane *wp, u_int px, u_int py)
@@ -72,97 +79,141 @@ screen_redraw_cell_border1(struct window_pane *wp, u_int px, u_int py)
 	return (-1);
 }
 
-/* Check if a cell is on the pane border. */
+/*
+ * Get the cell type from a bitmask of whether the cells to the left (bit 4),
+ * right, top, and bottom (bit 1) of a border cell are also borders.
+ */
 int
-screen_redraw_cell_border(struct client *c, u_int px, u_int py)
+screen_redraw_cell_type(int borders)
+{
+	/*
+	 * Only one bit set doesn't make sense (can't have a border cell with
+	 * no others connected).
+	 */
+	switch (borders) {
+	case 15:	/* 1111, left right top bottom */
+		return (CELL_JOIN);
+	case 14:	/* 1110, left right top */
+		return (CELL_BOTTOMJOIN);
+	case 13:	/* 1101, left right bottom */
+		return (CELL_TOPJOIN);
+	case 12:	/* 1100, left right */
+		return (CELL_TOPBOTTOM);
+	case 11:	/* 1011, left top bottom */
+		return (CELL_RIGHTJOIN);
+	case 10:	/* 1010, left top */
+		return (CELL_BOTTOMRIGHT);
+	case 9:		/* 1001, left bottom */
+		return (CELL_TOPRIGHT);
+	case 7:		/* 0111, right top bottom */
+		return (CELL_LEFTJOIN);
+	case 6:		/* 0110, right top */
+		return (CELL_BOTTOMLEFT);
+	case 5:		/* 0101, right bottom */
+		return (CELL_TOPLEFT);
+	case 3:		/* 0011, top bottom */
+		return (CELL_LEFTRIGHT);
+	}
+	return (CELL_OUTSIDE);
+}
+
+/*
+ * Build the map of cell types for a window, covering the window and one cell
+ * to its right and below. Checking every pane for every cell on each redraw is
+ * very slow with many panes, so this is done once after the layout changes.
+ */
+void
+screen_redraw_build_borders(struct window *w)
 {
-	struct window		*w = c->session->curw->window;
 	struct window_pane	*wp;
-	int			 retval;
+	u_char			*edge;
+	u_int			 sx, sy, px, py, xstart, ystart;
+	int			 borders;
 
-	/* Check all the panes. */
+	/*
+	 * First mark each cell as inside or on the border of the first pane
+	 * that covers it. Leave room for the neighbours of the last row and
+	 * column.
+	 */
+	sx = w->sx + 2;
+	sy = w->sy + 2;
+	edge = xcalloc(sx, sy);
 	TAILQ_FOREACH(wp, &w->panes, entry) {
 		if (!window_pane_visible(wp))
 			continue;
-		if ((retval = screen_redraw_cell_border1(wp, px, py)) != -1)
-			return (retval);
+		xstart = wp->xoff == 0 ? 0 : wp->xoff - 1;
+		ystart = wp->yoff == 0 ? 0 : wp->yoff - 1;
+		for (py = ystart; py <= wp->yoff + wp->sy; py++) {
+			for (px = xstart; px <= wp->xoff + wp->sx; px++) {
+				if (edge[py * sx + px] != BORDER_NONE)
+					continue;
+				switch (screen_redraw_cell_border1(wp, px, py)) {
+				case 0:
+					edge[py * sx + px] = BORDER_INSIDE;
+					break;
+				case 1:
+					edge[py * sx + px] = BORDER_EDGE;
+					break;
+				}
+			}
+		}
+	}
+
+	/* Then work out the type of each cell from its neighbours. */
+	free(w->border_map);
+	w->border_map = xcalloc(w->sx + 1, w->sy + 1);
+	w->border_sx = w->sx;
+	w->border_sy = w->sy;
+	for (py = 0; py <= w->sy; py++) {
+		for (px = 0; px <= w->sx; px++) {
+			switch (edge[py * sx + px]) {
+			case BORDER_NONE:
+				w->border_map[py * (w->sx + 1) + px] =
+				    CELL_OUTSIDE;
+				continue;
+			case BORDER_INSIDE:
+				w->border_map[py * (w->sx + 1) + px] =
+				    CELL_INSIDE;
+				continue;
+			}
+
+			borders = 0;
+			if (px == 0 || edge[py * sx + px - 1] == BORDER_EDGE)
+				borders |= 8;
+			if (edge[py * sx + px + 1] == BORDER_EDGE)
+				borders |= 4;
+			if (py == 0 || edge[(py - 1) * sx + px] == BORDER_EDGE)
+				borders |= 2;
+			if (edge[(py + 1) * sx + px] == BORDER_EDGE)
+				borders |= 1;
+			w->border_map[py * (w->sx + 1) + px] =
+			    screen_redraw_cell_type(borders);
+		}
 	}
+	free(edge);
+}
 
-	return (0);
+/* Discard the border map after the layout has changed. */
+void
+screen_redraw_invalidate(struct window *w)
+{
+	free(w->border_map);
+	w->border_map = NULL;
 }
 
 /* Check if cell inside a pane. */
 int
 screen_redraw_check_cell(struct client *c, u_int px, u_int py)
 {
-	struct window		*w = c->session->curw->window;
-	struct window_pane	*wp;
-	int			 borders;
+	struct window	*w = c->session->curw->window;
 
 	if (px > w->sx || py > w->sy)
 		return (CELL_OUTSIDE);
 
-	TAILQ_FOREACH(wp, &w->panes, entry) {
-		if (!window_pane_visible(wp))
-			continue;
-
-		/* If outside the pane and its border, skip it. */
-		if ((wp->xoff != 0 && px < wp->xoff - 1) ||
-		    px > wp->xoff + wp->sx ||
-		    (wp->yoff != 0 && py < wp->yoff - 1) ||
-		    py > wp->yoff + wp->sy)
-			continue;
-
-		/* If definitely inside, return so. */
-		if (!screen_redraw_cell_border(c, px, py))
-			return (CELL_INSIDE);
-
-		/*
-		 * Construct a bitmask of whether the cells to the left (bit
-		 * 4), right, top, and bottom (bit 1) of this cell are borders.
-		 */
-		borders = 0;
-		if (px == 0 || screen_redraw_cell_border(c, px - 1, py))
-			borders |= 8;
-		if (px <= w->sx && screen_redraw_cell_border(c, px + 1, py))
-			borders |= 4;
-		if (py == 0 || screen_redraw_cell_border(c, px, py - 1))
-			borders |= 2;
-		if (py <= w->sy && screen_redraw_cell_border(c, px, py + 1))
-			borders |= 1;
-
-		/*
-		 * Figure out what kind of border this cell is. Only one bit
-		 * set doesn't make sense (can't have a border cell with no
-		 * others connected).
-		 */
-		switch (borders) {
-		case 15:	/* 1111, left right top bottom */
-			return (CELL_JOIN);
-		case 14:	/* 1110, left right top */
-			return (CELL_BOTTOMJOIN);
-		case 13:	/* 1101, left right bottom */
-			return (CELL_TOPJOIN);
-		case 12:	/* 1100, left right */
-			return (CELL_TOPBOTTOM);
-		case 11:	/* 1011, left top bottom */
-			return (CELL_RIGHTJOIN);
-		case 10:	/* 1010, left top */
-			return (CELL_BOTTOMRIGHT);
-		case 9:		/* 1001, left bottom */
-			return (CELL_TOPRIGHT);
-		case 7:		/* 0111, right top bottom */
-			return (CELL_LEFTJOIN);
-		case 6:		/* 0110, right top */
-			return (CELL_BOTTOMLEFT);
-		case 5:		/* 0101, right bottom */
-			return (CELL_TOPLEFT);
-		case 3:		/* 0011, top bottom */
-			return (CELL_LEFTRIGHT);
-		}
-	}
-
-	return (CELL_OUTSIDE);
+	if (w->border_map == NULL ||
+	    w->border_sx != w->sx || w->border_sy != w->sy)
+		screen_redraw_build_borders(w);
+	return (w->border_map[py * (w->sx + 1) + px]);
 }
 
 /* Redraw entire screen. */
@@ -180,6 +231,10 @@ screen_redraw_screen(struct client *c, int status_only, int borders_only)
 	/* Suspended clients should not be updated. */
 	if (c->flags & CLIENT_SUSPENDED)
 		return;
+	if (!status_only && !borders_only) {
+		tty->redraws++;
+		global_stats.redraws++;
+	}
 
 	/* Get status line, er, status. */
 	spos = options_get_number(oo, "status-position");
@@ -944,6 +944,9 @@ screen_write_linefeed(struct screen_write_ctx *ctx, int wrapped)
 	else
 		gl->flags &= ~GRID_LINE_WRAPPED;
 
+	if (ctx->wp != NULL && s == &ctx->wp->base)
+		content_linefeed(ctx->wp, wrapped);
+
 	if (s->cy == s->rlower)
 		grid_view_scroll_region_up(s->grid, s->rupper, s->rlower);
 	else if (s->cy < screen_size_y(s) - 1)
@@ -1057,11 +1060,7 @@ screen_write_clearscreen(struct screen_write_ctx *ctx)
 void
 screen_write_clearhistory(struct screen_write_ctx *ctx)
 {
-	struct screen	*s = ctx->s;
-	struct grid	*gd = s->grid;
-
-	grid_move_lines(gd, 0, gd->hsize, gd->sy);
-	gd->hsize = 0;
+	grid_clear_history(ctx->s->grid);
 }
 
 /* Write cell data. */
@@ -1151,6 +1150,10 @@ screen_write_cell(struct screen_write_ctx *ctx,
 		grid_view_set_utf8(gd, s->cx, s->cy, &gu);
 	}
 
+	/* Look for monitor-content patterns in pane output. */
+	if (ctx->wp != NULL && s == &ctx->wp->base)
+		content_cell(ctx->wp, s->cx, s->cy, gc, utf8data);
+
 	/* Move the cursor. */
 	s->cx += width;
 
@@ -234,13 +234,16 @@ screen_resize_y(struct screen *s, u_int sy)
 				available = needed;
 			gd->hsize -= available;
 			s->cy += available;
+			grid_index_truncate(gd);
 		} else
 			available = 0;
 		needed -= available;
 
 		/* Then fill the rest in with blanks. */
-		for (i = gd->hsize + sy - needed; i < gd->hsize + sy; i++)
+		for (i = gd->hsize + sy - needed; i < gd->hsize + sy; i++) {
 			memset(&gd->linedata[i], 0, sizeof gd->linedata[i]);
+			gd->linedata[i].generation = ++gd->generation;
+		}
 	}
 
 	/* Set the new size, and reset the scroll region. */
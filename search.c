@@ -0,0 +1,370 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Nicholas Marriott <nicm@users.sourceforge.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include <sys/types.h>
+
+#include <regex.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tmux.h"
+
+/*
+ * Searching text from the grid. A pattern is compiled once, either a plain
+ * string found with Boyer-Moore-Horspool (or memchr for a single byte) or an
+ * extended regular expression. fnmatch(3) patterns are turned into regular
+ * expressions. Lines are searched as logical lines, with
+ * lines which wrap joined to the next, so a match may cross the edge of the
+ * pane.
+ */
+
+int	search_literal(struct search *, const char *, size_t, size_t, size_t *);
+void	search_text_add(struct search_text *, const void *, size_t, u_int,
+	    u_int);
+int	search_grid_line(struct search *, struct search_text *,
+	    int (*)(struct search_text *, size_t, size_t, void *), void *);
+
+/*
+ * Convert an fnmatch(3) pattern into an extended regular expression matching
+ * the same text anywhere in a line.
+ */
+char *
+search_glob(const char *pattern)
+{
+	const char	*cp, *end;
+	char		*re;
+	size_t		 len;
+
+	/* Each character needs at most two in the regular expression. */
+	re = xmalloc(2 * strlen(pattern) + 1);
+	len = 0;
+	for (cp = pattern; *cp != '\0'; cp++) {
+		switch (*cp) {
+		case '*':
+			re[len++] = '.';
+			re[len++] = '*';
+			continue;
+		case '?':
+			re[len++] = '.';
+			continue;
+		case '[':
+			/* Find the end, allowing ] first in the list. */
+			end = cp + 1;
+			if (*end == '!' || *end == '^')
+				end++;
+			if (*end == ']')
+				end++;
+			end = strchr(end, ']');
+			if (end == NULL)
+				break;
+			re[len++] = '[';
+			if (*++cp == '!') {
+				re[len++] = '^';
+				cp++;
+			}
+			while (cp != end)
+				re[len++] = *cp++;
+			re[len++] = ']';
+			continue;
+		case '\\':
+			if (cp[1] != '\0')
+				cp++;
+			break;
+		}
+		if (strchr("^$.|+()[]{}*?\\", *cp) != NULL)
+			re[len++] = '\\';
+		re[len++] = *cp;
+	}
+	re[len] = '\0';
+	return (re);
+}
+
+/* Compile a pattern. */
+int
+search_compile(struct search *sr, const char *string, int flags, char **cause)
+{
+	char	error[BUFSIZ], *re;
+	size_t	i;
+	int	retval;
+
+	memset(sr, 0, sizeof *sr);
+	sr->string = xstrdup(string);
+	sr->len = strlen(string);
+	sr->flags = flags;
+
+	if (flags & SEARCH_GLOB) {
+		sr->flags |= SEARCH_REGEX;
+		re = search_glob(string);
+		retval = regcomp(&sr->regex, re, REG_EXTENDED);
+		free(re);
+	} else if (flags & SEARCH_REGEX)
+		retval = regcomp(&sr->regex, string, REG_EXTENDED);
+	if (sr->flags & SEARCH_REGEX) {
+		if (retval != 0) {
+			regerror(retval, &sr->regex, error, sizeof error);
+			xasprintf(cause, "%s: %s", string, error);
+			free(sr->string);
+			sr->string = NULL;
+			return (-1);
+		}
+		return (0);
+	}
+
+	/* Bytes not in the pattern skip its whole length. */
+	for (i = 0; i < nitems(sr->skip); i++)
+		sr->skip[i] = sr->len;
+	for (i = 0; i + 1 < sr->len; i++)
+		sr->skip[(u_char) string[i]] = sr->len - 1 - i;
+	return (0);
+}
+
+/* Free a compiled pattern. */
+void
+search_free(struct search *sr)
+{
+	if (sr->string == NULL)
+		return;
+	if (sr->flags & SEARCH_REGEX)
+		regfree(&sr->regex);
+	free(sr->string);
+	sr->string = NULL;
+}
+
+/* Find a plain string at or after start. */
+int
+search_literal(struct search *sr, const char *buf, size_t len, size_t start,
+    size_t *off)
+{
+	const char	*s = sr->string, *found;
+	size_t		 n = sr->len, last, i;
+
+	if (n == 0 || n > len || start > len - n)
+		return (0);
+
+	if (n == 1) {
+		found = memchr(buf + start, *s, len - start);
+		if (found == NULL)
+			return (0);
+		*off = found - buf;
+		return (1);
+	}
+
+	last = n - 1;
+	for (i = start; i <= len - n; i += sr->skip[(u_char) buf[i + last]]) {
+		if (buf[i + last] == s[last] && memcmp(buf + i, s, last) == 0) {
+			*off = i;
+			return (1);
+		}
+	}
+	return (0);
+}
+
+/*
+ * Find the first match starting at or after start in a buffer, which must be
+ * terminated. Returns 1 and fills in the offset and size of the match if one
+ * is found.
+ */
+int
+search_find(struct search *sr, const char *buf, size_t len, size_t start,
+    size_t *off, size_t *size)
+{
+	regmatch_t	pm;
+
+	if (!(sr->flags & SEARCH_REGEX)) {
+		if (!search_literal(sr, buf, len, start, off))
+			return (0);
+		*size = sr->len;
+		return (1);
+	}
+
+	if (start > len)
+		return (0);
+	if (regexec(&sr->regex, buf + start, 1, &pm,
+	    start == 0 ? 0 : REG_NOTBOL) != 0)
+		return (0);
+	*off = start + pm.rm_so;
+	*size = pm.rm_eo - pm.rm_so;
+	return (1);
+}
+
+/* Initialise logical line text. */
+void
+search_text_init(struct search_text *st)
+{
+	memset(st, 0, sizeof *st);
+}
+
+/* Free logical line text. */
+void
+search_text_free(struct search_text *st)
+{
+	free(st->buf);
+	free(st->px);
+	free(st->py);
+}
+
+/* Add the bytes of one cell. */
+void
+search_text_add(struct search_text *st, const void *data, size_t size, u_int px,
+    u_int py)
+{
+	size_t	i;
+
+	if (st->len + size + 1 > st->size) {
+		st->size = (st->len + size + 1) * 2;
+		st->buf = xrealloc(st->buf, 1, st->size);
+		if (!(st->flags & SEARCH_TEXT_ONLY)) {
+			st->px = xrealloc(st->px, st->size, sizeof *st->px);
+			st->py = xrealloc(st->py, st->size, sizeof *st->py);
+		}
+	}
+
+	memcpy(st->buf + st->len, data, size);
+	if (st->flags & SEARCH_TEXT_ONLY) {
+		st->len += size;
+		return;
+	}
+	for (i = 0; i < size; i++) {
+		st->px[st->len] = px;
+		st->py[st->len] = py;
+		st->len++;
+	}
+}
+
+/*
+ * Fill in the text of the logical line starting at py and return the number
+ * of grid lines it takes up. Padding after wide characters is skipped, and so
+ * is anything after the last used cell of the line.
+ */
+u_int
+search_text_line(struct search_text *st, struct grid *gd, u_int py)
+{
+	const struct grid_line	*gl;
+	const struct grid_cell	*gc;
+	const struct grid_utf8	*gu;
+	u_int			 px, start = py;
+
+	st->len = 0;
+	for (; py < gd->hsize + gd->sy; py++) {
+		gl = &gd->linedata[py];
+		for (px = 0; px < gl->cellsize; px++) {
+			gc = &gl->celldata[px];
+			if (gc->flags & GRID_FLAG_PADDING)
+				continue;
+			if (gc->flags & GRID_FLAG_UTF8) {
+				gu = &gl->utf8data[px];
+				search_text_add(st, gu->data, grid_utf8_size(gu),
+				    px, py);
+			} else
+				search_text_add(st, &gc->data, 1, px, py);
+		}
+		if (!(gl->flags & GRID_LINE_WRAPPED)) {
+			py++;
+			break;
+		}
+	}
+
+	if (st->buf == NULL)
+		search_text_add(st, "", 0, 0, start);
+	st->buf[st->len] = '\0';
+	return (py - start);
+}
+
+/*
+ * Give each match in a line to a callback, which returns 0 to carry on, 1 to
+ * skip the rest of the line or -1 to stop. Plain strings may overlap.
+ */
+int
+search_grid_line(struct search *sr, struct search_text *st,
+    int (*cb)(struct search_text *, size_t, size_t, void *), void *data)
+{
+	size_t	start, off, size;
+	int	retval;
+
+	start = 0;
+	while (search_find(sr, st->buf, st->len, start, &off, &size)) {
+		if (off == st->len)
+			break;
+		if ((retval = cb(st, off, size, data)) != 0)
+			return (retval);
+
+		if (size == 0 || !(sr->flags & SEARCH_REGEX))
+			start = off + 1;
+		else
+			start = off + size;
+	}
+	return (0);
+}
+
+/*
+ * Search every logical line of a grid from the top, in order. If the grid has
+ * an index, only the history lines it says may match are searched.
+ */
+void
+search_grid(struct search *sr, struct grid *gd,
+    int (*cb)(struct search_text *, size_t, size_t, void *), void *data)
+{
+	struct search_text		 st;
+	struct grid_index_ranges	 ranges;
+	struct grid_index_range		*r;
+	u_int				 py, n, first, last, i;
+
+	search_text_init(&st);
+	ARRAY_INIT(&ranges);
+
+	py = 0;
+	if (grid_index_lookup(gd, sr, &ranges, &first, &last) == 0) {
+		for (; py < first; py += n) {
+			n = search_text_line(&st, gd, py);
+			if (search_grid_line(sr, &st, cb, data) == -1)
+				goto out;
+		}
+
+		/*
+		 * Search the logical lines starting in each range. A range may
+		 * begin part way through a line, which belongs to the range
+		 * before.
+		 */
+		for (i = 0; i < ARRAY_LENGTH(&ranges); i++) {
+			r = &ARRAY_ITEM(&ranges, i);
+			if (r->start > py) {
+				py = r->start;
+				while (py < r->end &&
+				    (gd->linedata[py - 1].flags & GRID_LINE_WRAPPED))
+					py++;
+			}
+			for (; py < r->end; py += n) {
+				n = search_text_line(&st, gd, py);
+				if (search_grid_line(sr, &st, cb, data) == -1)
+					goto out;
+			}
+		}
+		if (py < last)
+			py = last;
+	}
+	for (; py < gd->hsize + gd->sy; py += n) {
+		n = search_text_line(&st, gd, py);
+		if (search_grid_line(sr, &st, cb, data) == -1)
+			goto out;
+	}
+
+out:
+	ARRAY_FREE(&ranges);
+	search_text_free(&st);
+}
@@ -17,7 +17,9 @@
  */
 
 #include <sys/types.h>
+#include <sys/stat.h>
 
+#include <errno.h>
 #include <event.h>
 #include <fcntl.h>
 #include <stdlib.h>
@@ -27,6 +29,9 @@
 
 #include "tmux.h"
 
+/* Most stdin to read from a file descriptor at once. */
+#define SERVER_CLIENT_STDIN_READ 1048576
+
 void	server_client_check_mouse(struct client *, struct window_pane *);
 void	server_client_repeat_timer(int, short, void *);
 void	server_client_check_exit(struct client *);
@@ -34,16 +39,23 @@ void	server_client_check_redraw(struct client *);
 void	server_client_set_title(struct client *);
 void	server_client_reset_state(struct client *);
 int	server_client_assume_paste(struct session *);
+void	server_client_pane_key(struct client *, struct window_pane *, int);
 
 int	server_client_msg_dispatch(struct client *);
 void	server_client_msg_command(struct client *, struct msg_command_data *);
 void	server_client_msg_identify(
 	    struct client *, struct msg_identify_data *, int);
 void	server_client_msg_shell(struct client *);
+void	server_client_batch_callback(struct client *, int, void *);
+void	server_client_stdin_open(struct client *, int);
+void	server_client_stdin_callback(int, short, void *);
+void	server_client_stdin_close(struct client *);
+void	server_client_batch_end(struct client *);
 
 void printflike2 server_client_msg_error(struct cmd_ctx *, const char *, ...);
 void printflike2 server_client_msg_print(struct cmd_ctx *, const char *, ...);
 void printflike2 server_client_msg_info(struct cmd_ctx *, const char *, ...);
+void printflike2 server_client_batch_error(struct cmd_ctx *, const char *, ...);
 
 /* Create a new client. */
 void
@@ -66,6 +78,7 @@ server_client_create(int fd)
 	c->stdin_data = evbuffer_new ();
 	c->stdout_data = evbuffer_new ();
 	c->stderr_data = evbuffer_new ();
+	c->stdin_fd = -1;
 
 	c->tty.fd = -1;
 	c->title = NULL;
@@ -76,8 +89,6 @@ server_client_create(int fd)
 	c->tty.sy = 24;
 
 	screen_init(&c->status, c->tty.sx, 1, 0);
-	RB_INIT(&c->status_new);
-	RB_INIT(&c->status_old);
 
 	c->message_string = NULL;
 	ARRAY_INIT(&c->message_log);
@@ -86,6 +97,8 @@ server_client_create(int fd)
 	c->prompt_buffer = NULL;
 	c->prompt_index = 0;
 
+	RB_INIT(&c->control_panes);
+
 	c->tty.mouse.xb = c->tty.mouse.button = 3;
 	c->tty.mouse.x = c->tty.mouse.y = -1;
 	c->tty.mouse.lx = c->tty.mouse.ly = -1;
@@ -147,12 +160,14 @@ server_client_lost(struct client *c)
 	if (c->flags & CLIENT_TERMINAL)
 		tty_free(&c->tty);
 
+	if (c->stdin_fd != -1)
+		server_client_stdin_close(c);
 	evbuffer_free (c->stdin_data);
 	evbuffer_free (c->stdout_data);
 	evbuffer_free (c->stderr_data);
 
-	status_free_jobs(&c->status_new);
-	status_free_jobs(&c->status_old);
+	control_free(c);
+
 	screen_free(&c->status);
 
 	free(c->title);
@@ -204,6 +219,8 @@ void
 server_client_callback(int fd, short events, void *data)
 {
 	struct client	*c = data;
+	struct timeval	 tv;
+	int		 retval;
 
 	if (c->flags & CLIENT_DEAD)
 		return;
@@ -218,8 +235,13 @@ server_client_callback(int fd, short events, void *data)
 			return;
 		}
 
-		if (events & EV_READ && server_client_msg_dispatch(c) != 0)
-			goto client_lost;
+		if (events & EV_READ) {
+			stats_start(&tv);
+			retval = server_client_msg_dispatch(c);
+			stats_stop(STATS_CLIENT, &tv);
+			if (retval != 0)
+				goto client_lost;
+		}
 	}
 
 	server_push_stdout(c);
@@ -246,6 +268,8 @@ server_client_status_timer(void)
 	if (gettimeofday(&tv, NULL) != 0)
 		fatal("gettimeofday failed");
 
+	status_expire_jobs(tv.tv_sec);
+
 	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
 		c = ARRAY_ITEM(&clients, i);
 		if (c == NULL || c->session == NULL)
@@ -266,7 +290,7 @@ server_client_status_timer(void)
 
 		difference = tv.tv_sec - c->status_timer.tv_sec;
 		if (difference >= interval) {
-			status_update_jobs(c);
+			status_invalidate_session(s, tv.tv_sec);
 			c->flags |= CLIENT_STATUS;
 		}
 	}
@@ -341,6 +365,53 @@ server_client_assume_paste(struct session *s)
 	return 0;
 }
 
+/*
+ * Send a key to a pane. If it goes to the pty, remember when it was read so the
+ * time until the pane's next output can be recorded.
+ */
+void
+server_client_pane_key(struct client *c, struct window_pane *wp, int key)
+{
+	if (wp->mode == NULL && wp->fd != -1) {
+		memcpy(&c->key_time, &c->tty.key_time, sizeof c->key_time);
+		c->key_pane = wp->id;
+		wp->flags |= PANE_KEYECHO;
+	}
+	window_pane_key(wp, c->session, key);
+}
+
+/*
+ * A pane with keys waiting has produced output, which has now been written to
+ * the ttys of the clients displaying it. Record the latency for each client
+ * waiting for it.
+ */
+void
+server_client_key_echo(struct window_pane *wp)
+{
+	struct client	*c;
+	struct timeval	 tv;
+	u_int		 i;
+
+	wp->flags &= ~PANE_KEYECHO;
+	if (gettimeofday(&tv, NULL) != 0)
+		fatal("gettimeofday failed");
+
+	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
+		c = ARRAY_ITEM(&clients, i);
+		if (c == NULL || c->session == NULL)
+			continue;
+		if (!timerisset(&c->key_time) || c->key_pane != wp->id)
+			continue;
+
+		/* Only count it if the output reached the client. */
+		if (wp->mode == NULL &&
+		    c->session->curw->window == wp->window &&
+		    !(c->flags & CLIENT_SUSPENDED))
+			latency_add(&c->key_latency, &c->key_time, &tv);
+		timerclear(&c->key_time);
+	}
+}
+
 /* Handle data key input from client. */
 void
 server_client_handle_key(struct client *c, int key)
@@ -423,7 +494,7 @@ server_client_handle_key(struct client *c, int key)
 		/* Try as a non-prefix key binding. */
 		if (ispaste || (bd = key_bindings_lookup(key)) == NULL) {
 			if (!(c->flags & CLIENT_READONLY))
-				window_pane_key(wp, s, key);
+				server_client_pane_key(c, wp, key);
 		} else
 			key_bindings_dispatch(bd, c);
 		return;
@@ -438,7 +509,7 @@ server_client_handle_key(struct client *c, int key)
 			if (isprefix)
 				c->flags |= CLIENT_PREFIX;
 			else if (!(c->flags & CLIENT_READONLY))
-				window_pane_key(wp, s, key);
+				server_client_pane_key(c, wp, key);
 		}
 		return;
 	}
@@ -449,7 +520,7 @@ server_client_handle_key(struct client *c, int key)
 		if (isprefix)
 			c->flags |= CLIENT_PREFIX;
 		else if (!(c->flags & CLIENT_READONLY))
-			window_pane_key(wp, s, key);
+			server_client_pane_key(c, wp, key);
 		return;
 	}
 
@@ -599,6 +670,17 @@ server_client_check_exit(struct client *c)
 	if (!(c->flags & CLIENT_EXIT))
 		return;
 
+	/*
+	 * A batch command which had to wait has finished, so carry on with the
+	 * next one.
+	 */
+	if ((c->flags & CLIENT_BATCH) && c->batch_id != 0) {
+		c->flags &= ~CLIENT_EXIT;
+		server_client_batch_end(c);
+		server_client_batch_callback(c, c->stdin_closed, NULL);
+		return;
+	}
+
 	if (EVBUFFER_LENGTH(c->stdin_data) != 0)
 		return;
 	if (EVBUFFER_LENGTH(c->stdout_data) != 0)
@@ -692,7 +774,6 @@ server_client_msg_dispatch(struct client *c)
 	struct msg_command_data	 commanddata;
 	struct msg_identify_data identifydata;
 	struct msg_environ_data	 environdata;
-	struct msg_stdin_data	 stdindata;
 	ssize_t			 n, datalen;
 
 	if ((n = imsg_read(&c->ibuf)) == -1 || n == 0)
@@ -724,25 +805,24 @@ server_client_msg_dispatch(struct client *c)
 		case MSG_IDENTIFY:
 			if (datalen != sizeof identifydata)
 				fatalx("bad MSG_IDENTIFY size");
-			if (imsg.fd == -1)
-				fatalx("MSG_IDENTIFY missing fd");
 			memcpy(&identifydata, imsg.data, sizeof identifydata);
 
 			server_client_msg_identify(c, &identifydata, imsg.fd);
 			break;
 		case MSG_STDIN:
-			if (datalen != sizeof stdindata)
+			if ((size_t) datalen > MSG_DATA_SIZE)
 				fatalx("bad MSG_STDIN size");
-			memcpy(&stdindata, imsg.data, sizeof stdindata);
 
+			if (imsg.fd != -1) {
+				server_client_stdin_open(c, imsg.fd);
+				break;
+			}
 			if (c->stdin_callback == NULL)
 				break;
-			if (stdindata.size <= 0)
+			if (datalen == 0)
 				c->stdin_closed = 1;
-			else {
-				evbuffer_add(c->stdin_data, stdindata.data,
-				    stdindata.size);
-			}
+			else
+				evbuffer_add(c->stdin_data, imsg.data, datalen);
 			c->stdin_callback(c, c->stdin_closed,
 			    c->stdin_callback_data);
 			break;
@@ -804,6 +884,72 @@ server_client_msg_dispatch(struct client *c)
 	}
 }
 
+/* Read stdin directly from a file descriptor passed by the client. */
+void
+server_client_stdin_open(struct client *c, int fd)
+{
+	struct stat	sb;
+	struct timeval	tv;
+
+	if (c->stdin_callback == NULL || c->stdin_fd != -1) {
+		close(fd);
+		return;
+	}
+	c->stdin_fd = fd;
+	setblocking(fd, 0);
+
+	/* Regular files can't be polled, so read them from a timer. */
+	if (fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode)) {
+		evtimer_set(&c->stdin_event, server_client_stdin_callback, c);
+		timerclear(&tv);
+		evtimer_add(&c->stdin_event, &tv);
+	} else {
+		event_set(&c->stdin_event, fd, EV_READ|EV_PERSIST,
+		    server_client_stdin_callback, c);
+		event_add(&c->stdin_event, NULL);
+	}
+}
+
+/* Read what is available from client stdin, up to a limit each time. */
+/* ARGSUSED */
+void
+server_client_stdin_callback(unused int fd, unused short events, void *data)
+{
+	struct client	*c = data;
+	struct timeval	 tv;
+	char		 buf[BUFSIZ];
+	size_t		 total;
+	ssize_t		 n;
+
+	for (total = 0; total < SERVER_CLIENT_STDIN_READ; total += n) {
+		n = read(c->stdin_fd, buf, sizeof buf);
+		if (n == -1 && (errno == EINTR || errno == EAGAIN))
+			break;
+		if (n <= 0) {
+			server_client_stdin_close(c);
+			c->stdin_closed = 1;
+			break;
+		}
+		evbuffer_add(c->stdin_data, buf, n);
+	}
+	if (!c->stdin_closed && EVENT_FD(&c->stdin_event) == -1) {
+		timerclear(&tv);
+		evtimer_add(&c->stdin_event, &tv);
+	}
+
+	if (c->stdin_callback != NULL)
+		c->stdin_callback(c, c->stdin_closed, c->stdin_callback_data);
+}
+
+/* Stop reading client stdin. */
+void
+server_client_stdin_close(struct client *c)
+{
+	event_del(&c->stdin_event);
+	close(c->stdin_fd);
+	c->stdin_fd = -1;
+}
+
 /* Callback to send error message to client. */
 void printflike2
 server_client_msg_error(struct cmd_ctx *ctx, const char *fmt, ...)
@@ -907,6 +1053,95 @@ error:
 	c->flags |= CLIENT_EXIT;
 }
 
+/* Callback to send error message to batch client. */
+void printflike2
+server_client_batch_error(struct cmd_ctx *ctx, const char *fmt, ...)
+{
+	va_list	ap;
+
+	va_start(ap, fmt);
+	evbuffer_add_vprintf(ctx->cmdclient->stdout_data, fmt, ap);
+	va_end(ap);
+
+	evbuffer_add(ctx->cmdclient->stdout_data, "\n", 1);
+	server_push_stdout(ctx->cmdclient);
+	ctx->cmdclient->retcode = 1;
+}
+
+/*
+ * Batch input callback. Each line is a command, run in turn with its output
+ * and errors between %begin and %end lines tagged with the line number. A
+ * command which has to wait holds up the rest until it finishes and
+ * server_client_check_exit calls back in.
+ */
+/* ARGSUSED */
+void
+server_client_batch_callback(struct client *c, int closed, unused void *data)
+{
+	struct cmd_ctx	 ctx;
+	struct cmd_list	*cmdlist;
+	char		*line, *cause;
+	enum cmd_retval	 retval;
+
+	while (c->batch_id == 0) {
+		line = evbuffer_readln(c->stdin_data, NULL, EVBUFFER_EOL_LF);
+		if (line == NULL) {
+			if (closed) {
+				c->retcode = c->batch_retcode;
+				c->flags |= CLIENT_EXIT;
+			}
+			return;
+		}
+		c->batch_line++;
+
+		ctx.error = server_client_batch_error;
+		ctx.print = server_client_msg_print;
+		ctx.info = server_client_msg_info;
+
+		ctx.msgdata = NULL;
+		ctx.curclient = NULL;
+		ctx.cmdclient = c;
+
+		if (cmd_string_parse(line, &cmdlist, &cause) != 0 &&
+		    cause == NULL) {
+			/* Empty line or comment. */
+			free(line);
+			continue;
+		}
+		free(line);
+
+		c->batch_id = c->batch_line;
+		c->retcode = 0;
+		evbuffer_add_printf(c->stdout_data, "%%begin %u\n", c->batch_id);
+
+		if (cmdlist == NULL) {
+			server_client_batch_error(&ctx, "%s", cause);
+			free(cause);
+		} else {
+			retval = cmd_list_exec(cmdlist, &ctx);
+			cmd_list_free(cmdlist);
+			if (retval == CMD_RETURN_YIELD)
+				return;
+			if (retval == CMD_RETURN_ERROR)
+				c->retcode = 1;
+		}
+		server_client_batch_end(c);
+	}
+}
+
+/* Finish the current batch command. */
+void
+server_client_batch_end(struct client *c)
+{
+	evbuffer_add_printf(c->stdout_data, "%%end %u %d\n", c->batch_id,
+	    c->retcode);
+	server_push_stdout(c);
+
+	if (c->retcode != 0)
+		c->batch_retcode = c->retcode;
+	c->batch_id = 0;
+}
+
 /* Handle identify message. */
 void
 server_client_msg_identify(
@@ -925,10 +1160,26 @@ server_client_msg_identify(
 		c->tty.fd = -1;
 		c->tty.log_fd = -1;
 
-		close(fd);
+		if (fd != -1)
+			close(fd);
 		return;
 	}
 
+	if (data->flags & IDENTIFY_BATCH) {
+		c->stdin_callback = server_client_batch_callback;
+		c->flags |= CLIENT_BATCH;
+		server_write_client(c, MSG_STDIN, NULL, 0);
+
+		c->tty.log_fd = -1;
+
+		if (fd != -1)
+			close(fd);
+		return;
+	}
+
+	/* Clients which won't attach may not send their terminal. */
+	if (fd == -1)
+		return;
 	if (!isatty(fd)) {
 		close(fd);
 		return;
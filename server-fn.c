@@ -18,6 +18,7 @@
 
 #include <sys/types.h>
 
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
@@ -25,8 +26,13 @@
 
 #include "tmux.h"
 
+/* Most stdout or stderr messages to queue for a client at once. */
+#define SERVER_PUSH_QUEUE 8
+
 struct session *server_next_session(struct session *);
 void		server_callback_identify(int, short, void *);
+void		server_push_data(struct client *, enum msgtype,
+		    struct evbuffer *);
 
 void
 server_fill_environ(struct session *s, struct environ *env)
@@ -198,6 +204,7 @@ server_status_window(struct window *w)
 	 * current window.
 	 */
 
+	status_invalidate_window(w);
 	RB_FOREACH(s, sessions, &sessions) {
 		if (session_has(s, w) != NULL)
 			server_status_session(s);
@@ -513,47 +520,84 @@ server_update_event(struct client *c)
 	if (event_initialized(&c->event))
 		event_del(&c->event);
 	event_set(&c->event, c->ibuf.fd, events, server_client_callback, c);
+	event_priority_set(&c->event, EVENT_PRIORITY_INPUT);
 	event_add(&c->event, NULL);
 }
 
-/* Push stdout to client if possible. */
+/*
+ * Push data to client if possible. Only a few messages are queued at a time,
+ * the rest is pushed as they are written.
+ */
 void
-server_push_stdout(struct client *c)
+server_push_data(struct client *c, enum msgtype type, struct evbuffer *evb)
 {
-	struct msg_stdout_data data;
-	size_t                 size;
+	size_t	size;
 
-	size = EVBUFFER_LENGTH(c->stdout_data);
-	if (size == 0)
-		return;
-	if (size > sizeof data.data)
-		size = sizeof data.data;
+	while (c->ibuf.w.queued < SERVER_PUSH_QUEUE) {
+		size = EVBUFFER_LENGTH(evb);
+		if (size == 0)
+			return;
+		if (size > MSG_DATA_SIZE)
+			size = MSG_DATA_SIZE;
 
-	memcpy(data.data, EVBUFFER_DATA(c->stdout_data), size);
-	data.size = size;
+		if (server_write_client(c, type, EVBUFFER_DATA(evb), size) != 0)
+			return;
+		evbuffer_drain(evb, size);
+	}
+}
 
-	if (server_write_client(c, MSG_STDOUT, &data, sizeof data) == 0)
-		evbuffer_drain(c->stdout_data, size);
+/* Push stdout to client if possible. */
+void
+server_push_stdout(struct client *c)
+{
+	server_push_data(c, MSG_STDOUT, c->stdout_data);
 }
 
 /* Push stderr to client if possible. */
 void
 server_push_stderr(struct client *c)
 {
-	struct msg_stderr_data data;
-	size_t                 size;
+	server_push_data(c, MSG_STDERR, c->stderr_data);
+}
 
-	size = EVBUFFER_LENGTH(c->stderr_data);
-	if (size == 0)
-		return;
-	if (size > sizeof data.data)
-		size = sizeof data.data;
+/*
+ * Make a pipe to the client's stdout for bulk data and return the write end,
+ * which is nonblocking. Anything already waiting for stdout is queued first so
+ * it comes out in order.
+ */
+int
+server_stdout_pipe(struct client *c)
+{
+	struct evbuffer	*evb = c->stdout_data;
+	size_t		 size;
+	int		 fds[2];
+
+	if (pipe(fds) != 0)
+		return (-1);
+
+	while ((size = EVBUFFER_LENGTH(evb)) != 0) {
+		if (size > MSG_DATA_SIZE)
+			size = MSG_DATA_SIZE;
+		if (server_write_client(c, MSG_STDOUT, EVBUFFER_DATA(evb),
+		    size) != 0)
+			goto fail;
+		evbuffer_drain(evb, size);
+	}
+
+	log_debug("writing %d to client %d", MSG_STDOUT, c->ibuf.fd);
+	if (c->flags & CLIENT_BAD || imsg_compose(&c->ibuf,
+	    MSG_STDOUT, PROTOCOL_VERSION, -1, fds[0], NULL, 0) != 1)
+		goto fail;
+	server_update_event(c);
 
-	memcpy(data.data, EVBUFFER_DATA(c->stderr_data), size);
-	data.size = size;
+	setblocking(fds[1], 0);
+	return (fds[1]);
 
-	if (server_write_client(c, MSG_STDERR, &data, sizeof data) == 0)
-		evbuffer_drain(c->stderr_data, size);
+fail:
+	close(fds[0]);
+	close(fds[1]);
+	errno = EPIPE;
+	return (-1);
 }
 
 /* Set stdin callback. */
@@ -27,8 +27,7 @@
 int	server_window_check_bell(struct session *, struct winlink *);
 int	server_window_check_activity(struct session *, struct winlink *);
 int	server_window_check_silence(struct session *, struct winlink *);
-int	server_window_check_content(
-	    struct session *, struct winlink *, struct window_pane *);
+int	server_window_check_content(struct session *, struct winlink *);
 void	ring_bell(struct session *);
 
 /* Window functions that need to happen every loop. */
@@ -37,7 +36,6 @@ server_window_loop(void)
 {
 	struct window		*w;
 	struct winlink		*wl;
-	struct window_pane	*wp;
 	struct session		*s;
 	u_int		 	 i;
 
@@ -55,9 +53,11 @@ server_window_loop(void)
 			    server_window_check_activity(s, wl) ||
 			    server_window_check_silence(s, wl))
 				server_status_session(s);
-			TAILQ_FOREACH(wp, &w->panes, entry)
-				server_window_check_content(s, wl, wp);
+			server_window_check_content(s, wl);
 		}
+
+		/* Each match is only reported once. */
+		w->flags &= ~WINDOW_CONTENT;
 	}
 }
 
@@ -190,32 +190,22 @@ server_window_check_silence(struct session *s, struct winlink *wl)
 	return (1);
 }
 
-/* Check for content change in window. */
+/*
+ * Check for content in window. The panes set WINDOW_CONTENT when output
+ * matches monitor-content.
+ */
 int
-server_window_check_content(
-    struct session *s, struct winlink *wl, struct window_pane *wp)
+server_window_check_content(struct session *s, struct winlink *wl)
 {
 	struct client	*c;
 	struct window	*w = wl->window;
 	u_int		 i;
-	char		*found, *ptr;
-
-	/* Activity flag must be set for new content. */
-	if (s->curw->window == w)
-		w->flags &= ~WINDOW_ACTIVITY;
 
-	if (!(w->flags & WINDOW_ACTIVITY) || wl->flags & WINLINK_CONTENT)
+	if (!(w->flags & WINDOW_CONTENT) || wl->flags & WINLINK_CONTENT)
 		return (0);
 	if (s->curw == wl && !(s->flags & SESSION_UNATTACHED))
 		return (0);
 
-	ptr = options_get_string(&w->options, "monitor-content");
-	if (ptr == NULL || *ptr == '\0')
-		return (0);
-	if ((found = window_pane_search(wp, ptr, NULL)) == NULL)
-		return (0);
-	free(found);
-
 	if (options_get_number(&s->options, "bell-on-alert"))
 		ring_bell(s);
 	wl->flags |= WINLINK_CONTENT;
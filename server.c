@@ -133,6 +133,8 @@ server_start(int lockfd, char *lockfile)
 	/* event_init() was called in our parent, need to reinit. */
 	if (event_reinit(ev_base) != 0)
 		fatal("event_reinit failed");
+	if (event_base_priority_init(ev_base, EVENT_PRIORITIES) != 0)
+		fatal("event_base_priority_init failed");
 	clear_signals(0);
 
 	logfile("server");
@@ -197,11 +199,16 @@ server_start(int lockfd, char *lockfile)
 void
 server_loop(void)
 {
+	struct timeval	tv;
+
 	while (!server_should_shutdown()) {
 		event_loop(EVLOOP_ONCE);
+		global_stats.loops++;
 
+		stats_start(&tv);
 		server_window_loop();
 		server_client_loop();
+		stats_stop(STATS_REDRAW, &tv);
 
 		key_bindings_clean();
 		server_clean_dead();
@@ -476,6 +483,8 @@ server_second_callback(unused int fd, unused short events, unused void *arg)
 	struct timeval		 tv;
 	u_int		 	 i;
 
+	stats_start(&tv);
+
 	if (options_get_number(&global_s_options, "lock-server"))
 		server_lock_server();
 	else
@@ -494,6 +503,9 @@ server_second_callback(unused int fd, unused short events, unused void *arg)
 
 	server_client_status_timer();
 
+	stats_stop(STATS_TIMER, &tv);
+	stats_timer();
+
 	evtimer_del(&server_ev_second);
 	memset(&tv, 0, sizeof tv);
 	tv.tv_sec = 1;
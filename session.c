@@ -106,6 +106,10 @@ session_create(const char *name, const char *cmd, const char *cwd,
 
 	options_init(&s->options, &global_s_options);
 	environ_init(&s->environ);
+
+	s->status_list = NULL;
+	s->status_list_count = 0;
+	s->status_list_offset = 0;
 	if (env != NULL)
 		environ_copy(env, &s->environ);
 
@@ -169,6 +173,11 @@ session_destroy(struct session *s)
 		winlink_remove(&s->windows, wl);
 	}
 
+	if (s->status_list != NULL) {
+		screen_free(s->status_list);
+		free(s->status_list);
+	}
+
 	free(s->cwd);
 
 	RB_INSERT(sessions, &dead_sessions, s);
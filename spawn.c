@@ -0,0 +1,162 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Nicholas Marriott <nicm@users.sourceforge.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/types.h>
+#include <sys/ioctl.h>
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "tmux.h"
+
+/*
+ * Start child processes for panes and jobs.
+ *
+ * The server's address space grows with the history of every pane, so fork(2)
+ * gets steadily slower as there are more page tables to copy. Where possible
+ * vfork(2) is used instead: everything the child needs (arguments,
+ * environment, file descriptors and terminal settings) is prepared by the
+ * parent first, so the child only makes system calls before it execs. All
+ * signals are blocked while the child shares the parent's memory.
+ *
+ * The compat closefrom may call opendir(3), which allocates, so vfork(2) is
+ * only used with a native closefrom.
+ */
+
+#if defined(HAVE_VFORK) && defined(HAVE_CLOSEFROM)
+#define spawn_fork vfork
+#else
+#define spawn_fork fork
+#endif
+
+int		spawn_termios(int, const struct termios *, int);
+__dead void	spawn_exec(struct spawn *, sigset_t *);
+
+/* Set up the terminal settings for a new pane. */
+int
+spawn_termios(int fd, const struct termios *tio, int utf8)
+{
+	struct termios	tio2;
+
+	if (tcgetattr(fd, &tio2) != 0)
+		return (-1);
+	if (tio != NULL)
+		memcpy(tio2.c_cc, tio->c_cc, sizeof tio2.c_cc);
+	tio2.c_cc[VERASE] = '\177';
+#ifdef IUTF8
+	if (utf8)
+		tio2.c_iflag |= IUTF8;
+#endif
+	return (tcsetattr(fd, TCSANOW, &tio2));
+}
+
+/*
+ * Set up and exec the child. This may be running in the parent's address space
+ * so must not touch memory or return.
+ */
+__dead void
+spawn_exec(struct spawn *sp, sigset_t *oldset)
+{
+	int	i;
+
+	if (sp->flags & SPAWN_SETSID) {
+		if (setsid() == -1)
+			_exit(1);
+#ifdef TIOCSCTTY
+		if (ioctl(sp->fds[0], TIOCSCTTY, NULL) == -1)
+			_exit(1);
+#endif
+	}
+
+	for (i = 0; i < 3; i++) {
+		if (sp->fds[i] != -1 && sp->fds[i] != i) {
+			if (dup2(sp->fds[i], i) == -1)
+				_exit(1);
+		}
+	}
+	closefrom(STDERR_FILENO + 1);
+
+	if (sp->cwd != NULL && chdir(sp->cwd) != 0)
+		chdir("/");
+
+	clear_signals(1);
+	if (oldset != NULL)
+		sigprocmask(SIG_SETMASK, oldset, NULL);
+
+	execve(sp->path, sp->argv, sp->envp);
+	_exit(1);
+}
+
+/* Start a process with the given file descriptors. */
+pid_t
+spawn_process(struct spawn *sp)
+{
+	sigset_t	set, oldset;
+	pid_t		pid;
+
+	sigfillset(&set);
+	sigprocmask(SIG_BLOCK, &set, &oldset);
+
+	if ((pid = spawn_fork()) == 0)
+		spawn_exec(sp, &oldset);
+
+	sigprocmask(SIG_SETMASK, &oldset, NULL);
+	return (pid);
+}
+
+/*
+ * Start a process on a new pty, returning the pty master in fd and its name in
+ * name (which must be at least TTY_NAME_MAX). The control characters are taken
+ * from tio if it is not NULL.
+ */
+pid_t
+spawn_pane(struct spawn *sp, int *fd, char *name, struct winsize *ws,
+    const struct termios *tio, int utf8)
+{
+	pid_t	pid;
+#ifdef HAVE_FORKPTY
+	int	slave;
+
+	if (openpty(fd, &slave, name, NULL, ws) != 0)
+		return (-1);
+	if (spawn_termios(slave, tio, utf8) != 0) {
+		close(*fd);
+		close(slave);
+		return (-1);
+	}
+
+	sp->fds[0] = sp->fds[1] = sp->fds[2] = slave;
+	sp->flags |= SPAWN_SETSID;
+	if ((pid = spawn_process(sp)) == -1)
+		close(*fd);
+	close(slave);
+#else
+	/* No openpty; forkpty from compat does the session and pty setup. */
+	if ((pid = forkpty(fd, name, NULL, ws)) == 0) {
+		if (spawn_termios(STDIN_FILENO, tio, utf8) != 0)
+			_exit(1);
+		sp->fds[0] = sp->fds[1] = sp->fds[2] = -1;
+		sp->flags &= ~SPAWN_SETSID;
+		spawn_exec(sp, NULL);
+	}
+#endif
+	return (pid);
+}
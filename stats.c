@@ -0,0 +1,130 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Nicholas Marriott <nicm@users.sourceforge.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/types.h>
+#include <sys/time.h>
+
+#include <errno.h>
+#include <event.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tmux.h"
+
+/*
+ * Server statistics. The counters are always kept; they are shown by
+ * show-stats and formats and may be appended to a file every stats-interval
+ * seconds.
+ */
+
+struct stats	 global_stats;
+time_t		 stats_last;
+
+const char *stats_type_names[STATS_TYPES] = {
+	"client", "pane", "job", "redraw", "timer"
+};
+
+/* Start timing some work. */
+void
+stats_start(struct timeval *tv)
+{
+	if (gettimeofday(tv, NULL) != 0)
+		fatal("gettimeofday failed");
+}
+
+/* Add the time since stats_start to the time spent on a type of work. */
+void
+stats_stop(enum stats_type type, struct timeval *start)
+{
+	struct timeval	tv;
+
+	if (gettimeofday(&tv, NULL) != 0)
+		fatal("gettimeofday failed");
+	timersub(&tv, start, &tv);
+	if (tv.tv_sec < 0)
+		return;
+
+	global_stats.calls[type]++;
+	global_stats.time[type] += tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+/*
+ * Append the statistics to the stats-file if the interval has passed. The
+ * file may be a FIFO or on a slow filesystem, so it is written without
+ * blocking, and the sample is dropped if it will not all go at once.
+ */
+void
+stats_timer(void)
+{
+	const char	*path;
+	struct evbuffer	*evb;
+	time_t		 t;
+	ssize_t		 n;
+	size_t		 len;
+	int		 fd;
+	u_int		 i;
+
+	path = options_get_string(&global_options, "stats-file");
+	if (*path == '\0')
+		return;
+
+	t = time(NULL);
+	if (t - stats_last < options_get_number(&global_options,
+	    "stats-interval"))
+		return;
+	stats_last = t;
+
+	fd = open(path, O_WRONLY|O_APPEND|O_CREAT|O_NONBLOCK, 0666);
+	if (fd == -1) {
+		log_debug("%s: %s", path, strerror(errno));
+		return;
+	}
+	if (fcntl(fd, F_SETFD, FD_CLOEXEC) == -1)
+		fatal("fcntl failed");
+
+	evb = evbuffer_new();
+	evbuffer_add_printf(evb, "time=%lld loops=%llu pane_bytes=%llu input_bytes=%llu "
+	    "input_cells=%llu tty_bytes=%llu redraws=%llu format_expands=%llu "
+	    "job_forks=%llu", (long long) t, global_stats.loops,
+	    global_stats.pane_bytes, global_stats.input_bytes,
+	    global_stats.input_cells, global_stats.tty_bytes,
+	    global_stats.redraws, global_stats.format_expands,
+	    global_stats.job_forks);
+	for (i = 0; i < STATS_TYPES; i++) {
+		evbuffer_add_printf(evb, " %s_calls=%llu %s_usec=%llu", stats_type_names[i],
+		    global_stats.calls[i], stats_type_names[i],
+		    global_stats.time[i]);
+	}
+	evbuffer_add(evb, "\n", 1);
+
+	len = EVBUFFER_LENGTH(evb);
+	while ((n = write(fd, EVBUFFER_DATA(evb), len)) == -1) {
+		if (errno != EINTR)
+			break;
+	}
+	if (n == -1)
+		log_debug("%s: sample dropped: %s", path, strerror(errno));
+	else if ((size_t) n != len)
+		log_debug("%s: sample cut short", path);
+
+	evbuffer_free(evb);
+	close(fd);
+}
@@ -18,6 +18,7 @@
 
 #include <sys/types.h>
 #include <sys/time.h>
+#include <sys/wait.h>
 
 #include <errno.h>
 #include <limits.h>
@@ -33,11 +34,15 @@ char   *status_redraw_get_left(
 	    struct client *, time_t, int, struct grid_cell *, size_t *);
 char   *status_redraw_get_right(
 	    struct client *, time_t, int, struct grid_cell *, size_t *);
-char   *status_find_job(struct client *, char **);
+int	status_update_winlink(struct client *, struct winlink *, time_t, int,
+	    struct grid_cell *);
+void	status_update_list(struct session *, int, struct grid_cell *, u_int);
+char   *status_find_job(struct session *, char **);
+void	status_start_job(struct status_out *, struct timeval *);
 void	status_job_free(void *);
 void	status_job_callback(struct job *);
 char   *status_print(
-	    struct client *, struct winlink *, time_t, struct grid_cell *);
+	    struct session *, struct winlink *, time_t, struct grid_cell *);
 void	status_replace1(struct client *, struct session *, struct winlink *,
 	    struct window_pane *, char **, char **, char *, size_t, int);
 void	status_message_callback(int, short, void *);
@@ -47,9 +52,22 @@ const char *status_prompt_down_history(u_int *);
 void	status_prompt_add_history(const char *);
 char   *status_prompt_complete(const char *);
 
+/* Extra state bits for cached winlink entries, above WINLINK_ALERTFLAGS. */
+#define STATUS_CURRENT 0x100
+#define STATUS_LAST 0x200
+
 /* Status prompt history. */
 ARRAY_DECL(, char *) status_prompt_history = ARRAY_INITIALIZER;
 
+/*
+ * Generation of cached window list entries. Bumped when an option changes so
+ * every entry is rebuilt the next time it is drawn.
+ */
+u_int	status_generation = 1;
+
+/* Shared output of #() commands. */
+struct status_out_tree status_jobs = RB_INITIALIZER(&status_jobs);
+
 /* Status output tree. */
 RB_GENERATE(status_out_tree, status_out, entry, status_out_cmp);
 
@@ -74,6 +92,45 @@ status_at_line(struct client *c)
 	return (c->tty.sy - 1);
 }
 
+/* Invalidate all cached window list entries. */
+void
+status_invalidate_all(void)
+{
+	if (++status_generation == 0)
+		status_generation = 1;
+}
+
+/* Invalidate the cached entries for a window in every session. */
+void
+status_invalidate_window(struct window *w)
+{
+	struct session	*s;
+	struct winlink	*wl;
+
+	RB_FOREACH(s, sessions, &sessions) {
+		RB_FOREACH(wl, winlinks, &s->windows) {
+			if (wl->window == w)
+				wl->status_gen = 0;
+		}
+	}
+}
+
+/*
+ * Invalidate the cached entries for a session. If t is not zero, entries
+ * already built during that second are kept, so several clients of the same
+ * session reaching their status interval together only rebuild once.
+ */
+void
+status_invalidate_session(struct session *s, time_t t)
+{
+	struct winlink	*wl;
+
+	RB_FOREACH(wl, winlinks, &s->windows) {
+		if (t == 0 || wl->status_time != t)
+			wl->status_gen = 0;
+	}
+}
+
 /* Retrieve options for left string. */
 char *
 status_redraw_get_left(struct client *c,
@@ -158,15 +215,14 @@ status_redraw(struct client *c)
 	struct screen_write_ctx	ctx;
 	struct session	       *s = c->session;
 	struct winlink	       *wl;
-	struct screen		old_status, window_list;
+	struct screen		old_status, *window_list;
 	struct grid_cell	stdgc, lgc, rgc, gc;
-	struct options	       *oo;
 	time_t			t;
-	char		       *left, *right, *sep;
-	u_int			offset, needed;
+	char		       *left, *right;
+	u_int			offset, needed, n;
 	u_int			wlstart, wlwidth, wlavailable, wloffset, wlsize;
-	size_t			llen, rlen, seplen;
-	int			larrow, rarrow, utf8flag;
+	size_t			llen, rlen;
+	int			larrow, rarrow, utf8flag, changed;
 
 	/* No status line? */
 	if (c->tty.sy == 0 || !options_get_number(&s->options, "status"))
@@ -219,38 +275,23 @@ status_redraw(struct client *c)
 		goto out;
 	wlavailable = c->tty.sx - needed;
 
-	/* Calculate the total size needed for the window list. */
-	wlstart = wloffset = wlwidth = 0;
-	RB_FOREACH(wl, winlinks, &s->windows) {
-		free(wl->status_text);
-		memcpy(&wl->status_cell, &stdgc, sizeof wl->status_cell);
-		wl->status_text = status_print(c, wl, t, &wl->status_cell);
-		wl->status_width =
-		    screen_write_cstrlen(utf8flag, "%s", wl->status_text);
-
-		if (wl == s->curw)
-			wloffset = wlwidth;
-
-		oo = &wl->window->options;
-		sep = options_get_string(oo, "window-status-separator");
-		seplen = screen_write_strlen(utf8flag, "%s", sep);
-		wlwidth += wl->status_width + seplen;
-	}
-
-	/* Create a new screen for the window list. */
-	screen_init(&window_list, wlwidth, 1, 0);
-
-	/* And draw the window list into it. */
-	screen_write_start(&ctx, NULL, &window_list);
+	/*
+	 * Bring the cached entry of each window up to date and rebuild the
+	 * shared window list only if any of them changed.
+	 */
+	changed = 0;
+	n = 0;
 	RB_FOREACH(wl, winlinks, &s->windows) {
-		screen_write_cnputs(&ctx,
-		    -1, &wl->status_cell, utf8flag, "%s", wl->status_text);
-
-		oo = &wl->window->options;
-		sep = options_get_string(oo, "window-status-separator");
-		screen_write_nputs(&ctx, -1, &stdgc, utf8flag, "%s", sep);
+		if (status_update_winlink(c, wl, t, utf8flag, &stdgc))
+			changed = 1;
+		n++;
 	}
-	screen_write_stop(&ctx);
+	if (changed || s->status_list == NULL || s->status_list_count != n)
+		status_update_list(s, utf8flag, &stdgc, n);
+	window_list = s->status_list;
+	wlwidth = screen_size_x(window_list);
+	wloffset = s->status_list_offset;
+	wlstart = 0;
 
 	/* If there is enough space for the total width, skip to draw now. */
 	if (wlwidth <= wlavailable)
@@ -291,10 +332,8 @@ status_redraw(struct client *c)
 	}
 
 	/* Bail if anything is now too small too. */
-	if (wlwidth == 0 || wlavailable == 0) {
-		screen_free(&window_list);
+	if (wlwidth == 0 || wlavailable == 0)
 		goto out;
-	}
 
 	/*
 	 * Now the start position is known, work out the state of the left and
@@ -365,8 +404,7 @@ draw:
 	/* Copy the window list. */
 	c->wlmouse = -wloffset + wlstart;
 	screen_write_cursormove(&ctx, wloffset, 0);
-	screen_write_copy(&ctx, &window_list, wlstart, 0, wlwidth, 1);
-	screen_free(&window_list);
+	screen_write_copy(&ctx, window_list, wlstart, 0, wlwidth, 1);
 
 	screen_write_stop(&ctx);
 
@@ -382,6 +420,88 @@ out:
 	return (1);
 }
 
+/*
+ * Rebuild the cached status line entry for a winlink if it is out of date.
+ * Returns 1 if the entry was rebuilt.
+ */
+int
+status_update_winlink(struct client *c, struct winlink *wl, time_t t,
+    int utf8flag, struct grid_cell *stdgc)
+{
+	struct session	*s = c->session;
+	int		 state;
+
+	state = wl->flags & WINLINK_ALERTFLAGS;
+	if (wl == s->curw)
+		state |= STATUS_CURRENT;
+	if (wl == TAILQ_FIRST(&s->lastw))
+		state |= STATUS_LAST;
+
+	if (wl->status_text != NULL &&
+	    wl->status_gen == status_generation &&
+	    wl->status_state == state &&
+	    wl->status_pane == wl->window->active)
+		return (0);
+
+	free(wl->status_text);
+	memcpy(&wl->status_cell, stdgc, sizeof wl->status_cell);
+	wl->status_text = status_print(s, wl, t, &wl->status_cell);
+	wl->status_width =
+	    screen_write_cstrlen(utf8flag, "%s", wl->status_text);
+
+	wl->status_gen = status_generation;
+	wl->status_state = state;
+	wl->status_pane = wl->window->active;
+	wl->status_time = t;
+	return (1);
+}
+
+/* Draw the cached winlink entries into the session window list. */
+void
+status_update_list(struct session *s, int utf8flag, struct grid_cell *stdgc,
+    u_int n)
+{
+	struct screen_write_ctx	 ctx;
+	struct winlink		*wl;
+	struct options		*oo;
+	char			*sep;
+	size_t			 seplen;
+	u_int			 wlwidth, wloffset;
+
+	/* Calculate the total size needed for the window list. */
+	wlwidth = wloffset = 0;
+	RB_FOREACH(wl, winlinks, &s->windows) {
+		if (wl == s->curw)
+			wloffset = wlwidth;
+
+		oo = &wl->window->options;
+		sep = options_get_string(oo, "window-status-separator");
+		seplen = screen_write_strlen(utf8flag, "%s", sep);
+		wlwidth += wl->status_width + seplen;
+	}
+
+	/* Create a new screen for the window list. */
+	if (s->status_list != NULL)
+		screen_free(s->status_list);
+	else
+		s->status_list = xmalloc(sizeof *s->status_list);
+	screen_init(s->status_list, wlwidth, 1, 0);
+	s->status_list_count = n;
+	s->status_list_offset = wloffset;
+
+	/* And draw the window list into it. */
+	screen_write_start(&ctx, NULL, s->status_list);
+	RB_FOREACH(wl, winlinks, &s->windows) {
+		screen_write_cnputs(&ctx,
+		    -1, &wl->status_cell, utf8flag, "%s", wl->status_text);
+
+		oo = &wl->window->options;
+		sep = options_get_string(oo, "window-status-separator");
+		screen_write_nputs(&ctx, -1, stdgc, utf8flag, "%s", sep);
+	}
+	screen_write_stop(&ctx);
+}
+
 /* Replace a single special sequence (prefixed by #). */
 void
 status_replace1(struct client *c, struct session *s, struct winlink *wl,
@@ -418,7 +538,7 @@ status_replace1(struct client *c, struct session *s, struct winlink *wl,
 			ch = ')';
 			goto skip_to;
 		}
-		if ((ptr = status_find_job(c, iptr)) == NULL)
+		if ((ptr = status_find_job(s, iptr)) == NULL)
 			return;
 		goto do_replace;
 	case 'D':
@@ -539,9 +659,10 @@ status_replace(struct client *c, struct session *s, struct winlink *wl,
 
 /* Figure out job name and get its result, starting it off if necessary. */
 char *
-status_find_job(struct client *c, char **iptr)
+status_find_job(struct session *s, char **iptr)
 {
 	struct status_out	*so, so_find;
+	struct timeval		 tv;
 	char   			*cmd;
 	int			 lastesc;
 	size_t			 len;
@@ -574,91 +695,111 @@ status_find_job(struct client *c, char **iptr)
 	(*iptr)++;			/* skip final ) */
 	cmd[len] = '\0';
 
-	/* First try in the new tree. */
+	/* Find the shared entry for this command, adding it if missing. */
 	so_find.cmd = cmd;
-	so = RB_FIND(status_out_tree, &c->status_new, &so_find);
-	if (so != NULL && so->out != NULL) {
+	so = RB_FIND(status_out_tree, &status_jobs, &so_find);
+	if (so == NULL) {
+		so = xcalloc(1, sizeof *so);
+		so->cmd = cmd;
+		RB_INSERT(status_out_tree, &status_jobs, so);
+	} else
 		free(cmd);
-		return (so->out);
-	}
 
-	/* If not found at all, start the job and add to the tree. */
-	if (so == NULL) {
-		job_run(cmd, status_job_callback, status_job_free, c);
-		c->references++;
+	if (gettimeofday(&tv, NULL) != 0)
+		fatal("gettimeofday failed");
+	so->used = tv.tv_sec;
+	so->interval = options_get_number(&s->options, "status-interval");
 
-		so = xmalloc(sizeof *so);
-		so->cmd = xstrdup(cmd);
-		so->out = NULL;
-		RB_INSERT(status_out_tree, &c->status_new, so);
-	}
+	/*
+	 * Start the job if it has never run or if the last run is older than
+	 * the status interval and it is not already running. The previous
+	 * output is used until the new job finishes.
+	 */
+	if (so->job == NULL && (so->runs == 0 ||
+	    (so->interval != 0 && tv.tv_sec - so->start.tv_sec >= so->interval)))
+		status_start_job(so, &tv);
+	return (so->out);
+}
 
-	/* Lookup in the old tree. */
-	so_find.cmd = cmd;
-	so = RB_FIND(status_out_tree, &c->status_old, &so_find);
-	free(cmd);
-	if (so != NULL)
-		return (so->out);
-	return (NULL);
+/* Start the job for a status output entry. */
+void
+status_start_job(struct status_out *so, struct timeval *tv)
+{
+	memcpy(&so->start, tv, sizeof so->start);
+	so->runs++;
+
+	so->job = job_run(so->cmd, status_job_callback, status_job_free, so);
+	if (so->job == NULL)
+		so->failures++;
 }
 
-/* Free job tree. */
+/* Force all jobs to be run again when next needed. */
 void
-status_free_jobs(struct status_out_tree *sotree)
+status_update_jobs(void)
+{
+	struct status_out	*so;
+
+	RB_FOREACH(so, status_out_tree, &status_jobs)
+		so->start.tv_sec = 0;
+}
+
+/*
+ * Free any job output that has not been wanted recently, which is twice the
+ * status interval or at least STATUS_JOB_EXPIRE seconds.
+ */
+void
+status_expire_jobs(time_t t)
 {
 	struct status_out	*so, *so_next;
+	time_t			 expire;
 
-	so_next = RB_MIN(status_out_tree, sotree);
+	so_next = RB_MIN(status_out_tree, &status_jobs);
 	while (so_next != NULL) {
 		so = so_next;
-		so_next = RB_NEXT(status_out_tree, sotree, so);
+		so_next = RB_NEXT(status_out_tree, &status_jobs, so);
+
+		if (so->job != NULL)
+			continue;
+		expire = so->interval * 2;
+		if (expire < STATUS_JOB_EXPIRE)
+			expire = STATUS_JOB_EXPIRE;
+		if (t - so->used <= expire)
+			continue;
 
-		RB_REMOVE(status_out_tree, sotree, so);
+		RB_REMOVE(status_out_tree, &status_jobs, so);
 		free(so->out);
 		free(so->cmd);
 		free(so);
 	}
 }
 
-/* Update jobs on status interval. */
-void
-status_update_jobs(struct client *c)
-{
-	/* Free the old tree. */
-	status_free_jobs(&c->status_old);
-
-	/* Move the new to old. */
-	memcpy(&c->status_old, &c->status_new, sizeof c->status_old);
-	RB_INIT(&c->status_new);
-}
-
 /* Free status job. */
 void
 status_job_free(void *data)
 {
-	struct client	*c = data;
+	struct status_out	*so = data;
 
-	c->references--;
+	so->job = NULL;
 }
 
 /* Job has finished: save its result. */
 void
 status_job_callback(struct job *job)
 {
-	struct client		*c = job->data;
-	struct status_out	*so, so_find;
+	struct status_out	*so = job->data;
+	struct client		*c;
+	struct timeval		 tv;
 	char			*line, *buf;
 	size_t			 len;
+	u_int			 i;
 
-	if (c->flags & CLIENT_DEAD)
-		return;
-
-	so_find.cmd = job->cmd;
-	so = RB_FIND(status_out_tree, &c->status_new, &so_find);
-	if (so == NULL || so->out != NULL)
-		return;
+	if (gettimeofday(&tv, NULL) != 0)
+		fatal("gettimeofday failed");
+	timersub(&tv, &so->start, &tv);
+	so->latency = tv.tv_sec * 1000 + tv.tv_usec / 1000;
+	if (!WIFEXITED(job->status) || WEXITSTATUS(job->status) != 0)
+		so->failures++;
 
-	buf = NULL;
 	if ((line = evbuffer_readline(job->event->input)) == NULL) {
 		len = EVBUFFER_LENGTH(job->event->input);
 		buf = xmalloc(len + 1);
@@ -666,19 +807,34 @@ status_job_callback(struct job *job)
 			memcpy(buf, EVBUFFER_DATA(job->event->input), len);
 		buf[len] = '\0';
 	} else
-		buf = xstrdup(line);
+		buf = line;
 
+	/* Nothing to redraw if the output is the same as last time. */
+	if (so->out != NULL && strcmp(so->out, buf) == 0) {
+		free(buf);
+		return;
+	}
+	free(so->out);
 	so->out = buf;
-	server_status_client(c);
+
+	status_invalidate_all();
+	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
+		c = ARRAY_ITEM(&clients, i);
+		if (c != NULL && c->session != NULL)
+			server_status_client(c);
+	}
 }
 
-/* Return winlink status line entry and adjust gc as necessary. */
+/*
+ * Return winlink status line entry and adjust gc as necessary. The entry is
+ * cached and shared by every client attached to the session, so it is built
+ * without a client and may not depend on one.
+ */
 char *
 status_print(
-    struct client *c, struct winlink *wl, time_t t, struct grid_cell *gc)
+    struct session *s, struct winlink *wl, time_t t, struct grid_cell *gc)
 {
 	struct options	*oo = &wl->window->options;
-	struct session	*s = c->session;
 	const char	*fmt;
 	char   		*text;
 	int		 fg, bg, attr;
@@ -749,7 +905,7 @@ status_print(
 			gc->attr = attr;
 	}
 
-	text = status_replace(c, NULL, wl, NULL, fmt, t, 1);
+	text = status_replace(NULL, s, wl, NULL, fmt, t, 1);
 	return (text);
 }
 
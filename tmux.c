@@ -42,6 +42,7 @@ struct event_base *ev_base;
 
 char		*cfg_file;
 char		*shell_cmd;
+char		*batch_file;
 int		 debug_level;
 time_t		 start_time;
 char		 socket_path[MAXPATHLEN];
@@ -62,8 +63,8 @@ __dead void
 usage(void)
 {
 	fprintf(stderr,
-	    "usage: %s [-28lquvV] [-c shell-command] [-f file] [-L socket-name]\n"
-	    "            [-S socket-path] [command [flags]]\n",
+	    "usage: %s [-28lquvV] [-b batch-file] [-c shell-command] [-f file]\n"
+	    "            [-L socket-name] [-S socket-path] [command [flags]]\n",
 	    __progname);
 	exit(1);
 }
@@ -247,7 +248,7 @@ main(int argc, char **argv)
 	quiet = flags = 0;
 	label = path = NULL;
 	login_shell = (**argv == '-');
-	while ((opt = getopt(argc, argv, "28c:Cdf:lL:qS:uUvV")) != -1) {
+	while ((opt = getopt(argc, argv, "28b:c:Cdf:lL:qS:uUvV")) != -1) {
 		switch (opt) {
 		case '2':
 			flags |= IDENTIFY_256COLOURS;
@@ -257,6 +258,10 @@ main(int argc, char **argv)
 			flags |= IDENTIFY_88COLOURS;
 			flags &= ~IDENTIFY_256COLOURS;
 			break;
+		case 'b':
+			free(batch_file);
+			batch_file = xstrdup(optarg);
+			break;
 		case 'c':
 			free(shell_cmd);
 			shell_cmd = xstrdup(optarg);
@@ -303,6 +308,8 @@ main(int argc, char **argv)
 
 	if (shell_cmd != NULL && argc != 0)
 		usage();
+	if (batch_file != NULL && (shell_cmd != NULL || argc != 0))
+		usage();
 
 	if (!(flags & IDENTIFY_UTF8)) {
 		/*
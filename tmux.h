@@ -19,7 +19,7 @@
 #ifndef TMUX_H
 #define TMUX_H
 
-#define PROTOCOL_VERSION 7
+#define PROTOCOL_VERSION 9
 
 #include <sys/param.h>
 #include <sys/time.h>
@@ -27,6 +27,7 @@
 
 #include <event.h>
 #include <limits.h>
+#include <regex.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -55,6 +56,18 @@ extern char   **environ;
 /* Automatic name refresh interval, in milliseconds. */
 #define NAME_INTERVAL 500
 
+/* Minimum time unused status job output is kept, in seconds. */
+#define STATUS_JOB_EXPIRE 60
+
+/*
+ * Server event priorities. Only the most urgent events which are ready are run
+ * on each loop, so input from clients is handled before output from panes and
+ * jobs. Everything else is in the middle.
+ */
+#define EVENT_PRIORITIES 3
+#define EVENT_PRIORITY_INPUT 0
+#define EVENT_PRIORITY_OUTPUT 2
+
 /*
  * Maximum sizes of strings in message data. Don't forget to bump
  * PROTOCOL_VERSION if any of these change!
@@ -153,6 +166,11 @@ extern char   **environ;
 	"(#{window_panes} panes) "				\
 	"[#{window_width}x#{window_height}] "
 
+/* Default template for search-panes. */
+#define SEARCH_PANES_TEMPLATE					\
+	"#{session_name}:#{window_index}.#{pane_index} "	\
+	"#{search_line}: #{search_match}"
+
 /* Default templates for break-pane, new-window and split-window. */
 #define BREAK_PANE_TEMPLATE "#{session_name}:#{window_index}.#{pane_index}"
 #define NEW_WINDOW_TEMPLATE BREAK_PANE_TEMPLATE
@@ -473,6 +491,7 @@ struct msg_identify_data {
 #define IDENTIFY_88COLOURS 0x4
 #define IDENTIFY_CONTROL 0x8
 #define IDENTIFY_TERMIOS 0x10
+#define IDENTIFY_BATCH 0x20
 	int		flags;
 };
 
@@ -492,20 +511,14 @@ struct msg_exit_data {
 	int		retcode;
 };
 
-struct msg_stdin_data {
-	ssize_t	size;
-	char	data[BUFSIZ];
-};
-
-struct msg_stdout_data {
-	ssize_t	size;
-	char	data[BUFSIZ];
-};
-
-struct msg_stderr_data {
-	ssize_t	size;
-	char	data[BUFSIZ];
-};
+/*
+ * MSG_STDIN, MSG_STDOUT and MSG_STDERR are just the data, up to MSG_DATA_SIZE
+ * bytes. An empty MSG_STDIN from the client is end of file. For bulk data,
+ * the client may instead send its stdin file descriptor with MSG_STDIN and
+ * the server may send the read end of a pipe with MSG_STDOUT, which the
+ * client copies to its stdout before going on to the next message.
+ */
+#define MSG_DATA_SIZE (MAX_IMSGSIZE - IMSG_HEADER_SIZE)
 
 /* Mode key commands. */
 enum mode_key_cmd {
@@ -733,6 +746,8 @@ struct grid_line {
 	u_int	utf8size;
 	struct grid_utf8 *utf8data;
 
+	unsigned long long generation;	/* grid generation when last changed */
+
 	int	flags;
 } __packed;
 
@@ -746,9 +761,21 @@ struct grid {
 
 	u_int	hsize;
 	u_int	hlimit;
+	u_int	hremoved;	/* lines removed from the top of history */
+
+	unsigned long long generation;	/* increased on every change */
 
 	struct grid_line *linedata;
+
+	struct grid_index *index;	/* history search index, if any */
+};
+
+/* Range of lines which may match a search. */
+struct grid_index_range {
+	u_int	start;
+	u_int	end;
 };
+ARRAY_DECL(grid_index_ranges, struct grid_index_range);
 
 /* Option data structures. */
 struct options_entry {
@@ -788,6 +815,19 @@ struct job {
 };
 LIST_HEAD(joblist, job);
 
+/* Process to be started by spawn_process or spawn_pane. */
+struct spawn {
+	const char	*path;
+	char	       **argv;
+	char	       **envp;
+	const char	*cwd;		/* NULL to not change */
+
+	int		 fds[3];	/* -1 to leave alone */
+
+	int		 flags;
+#define SPAWN_SETSID 0x1
+};
+
 /* Screen selection. */
 struct screen_sel {
 	int		 flag;
@@ -915,6 +955,65 @@ struct window_choose_mode_item {
 #define TREE_EXPANDED 0x1
 };
 
+/* Pane recording. */
+#define RECORD_MAGIC "tmuxrec\001"
+#define RECORD_MAGICLEN 8
+#define RECORD_HEADERLEN 9
+enum record_type {
+	RECORD_DATA,
+	RECORD_SIZE
+};
+struct record_entry {
+	enum record_type type;
+	u_int		 time;	/* milliseconds since start */
+
+	const u_char	*data;
+	size_t		 size;
+};
+
+/* pipe-pane-policy option. */
+#define PIPE_PANE_DROP_OLDEST 0
+#define PIPE_PANE_DROP_NEWEST 1
+#define PIPE_PANE_PAUSE 2
+
+/*
+ * Pane output waiting for pipes. Each read is copied once into a chunk which
+ * is shared by every pipe it has not yet been written to.
+ */
+struct pipe_chunk {
+	u_char		*data;
+	size_t		 size;
+	u_int		 references;
+};
+struct pipe_ref {
+	struct pipe_chunk *chunk;
+	size_t		 off;
+	size_t		 size;
+
+	TAILQ_ENTRY(pipe_ref) entry;
+};
+
+/* Pipe from a pane to a command. */
+struct pane_pipe {
+	char		*name;
+	char		*cmd;
+	struct window_pane *wp;
+
+	int		 fd;
+	struct event	 event;
+
+	int		 policy;
+	int		 flags;
+#define PIPE_PAUSED 0x1
+
+	TAILQ_HEAD(, pipe_ref) refs;
+	size_t		 waiting;
+	unsigned long long dropped;
+
+	TAILQ_ENTRY(pane_pipe) entry;
+};
+TAILQ_HEAD(pane_pipes, pane_pipe);
+
 /* Child window structure. */
 struct window_pane {
 	u_int		 id;
@@ -931,6 +1030,8 @@ struct window_pane {
 	int		 flags;
 #define PANE_REDRAW 0x1
 #define PANE_DROP 0x2
+#define PANE_KEYECHO 0x4
+#define PANE_PIPEPAUSE 0x8
 
 	char		*cmd;
 	char		*shell;
@@ -939,8 +1040,11 @@ struct window_pane {
 	pid_t		 pid;
 	char		 tty[TTY_NAME_MAX];
 
+	unsigned long long bytes;	/* read from the pty */
+
 	u_int		 changes;
 	struct event	 changes_timer;
+	struct event	 input_timer;
 	u_int		 changes_redraw;
 
 	int		 fd;
@@ -948,10 +1052,16 @@ struct window_pane {
 
 	struct input_ctx ictx;
 
-	int		 pipe_fd;
-	struct bufferevent *pipe_event;
+	struct pane_pipes pipes;
 	size_t		 pipe_off;
 
+	struct record	*record;
+	struct replay	*replay;
+
+	u_int		 content_state;	/* monitor-content matching */
+	u_int		 content_cx;
+	u_int		 content_cy;
+
 	struct screen	*screen;
 	struct screen	 base;
 
@@ -987,13 +1097,20 @@ struct window {
 	u_int		 sx;
 	u_int		 sy;
 
+	/* Cell types for drawing borders, built when the layout changes. */
+	u_char		*border_map;
+	u_int		 border_sx;
+	u_int		 border_sy;
+
 	int		 flags;
 #define WINDOW_BELL 0x1
 #define WINDOW_ACTIVITY 0x2
 #define WINDOW_REDRAW 0x4
 #define WINDOW_SILENCE 0x8
+#define WINDOW_CONTENT 0x10
 
 	struct options	 options;
+	struct content	*content;	/* compiled monitor-content */
 
 	u_int		 references;
 };
@@ -1004,9 +1121,18 @@ struct winlink {
 	int		 idx;
 	struct window	*window;
 
+	/*
+	 * Cached status line entry. Rebuilt when status_gen is out of date or
+	 * the state the text was built from (alert flags, current or last
+	 * window, active pane) no longer matches.
+	 */
 	size_t		 status_width;
 	struct grid_cell status_cell;
 	char		*status_text;
+	u_int		 status_gen;
+	int		 status_state;
+	struct window_pane *status_pane;
+	time_t		 status_time;
 
 	int              flags;
 #define WINLINK_BELL 0x1
@@ -1057,6 +1183,35 @@ struct paste_buffer {
 };
 ARRAY_DECL(paste_stack, struct paste_buffer *);
 
+/* Compiled search pattern. */
+struct search {
+	char		*string;
+	size_t		 len;
+
+#define SEARCH_REGEX 0x1
+#define SEARCH_GLOB 0x2
+	int		 flags;
+
+	regex_t		 regex;
+	size_t		 skip[UCHAR_MAX + 1];
+};
+
+/*
+ * Text of a logical line (grid lines joined where they wrap), with the cell
+ * each byte came from unless only the text is wanted.
+ */
+struct search_text {
+	char		*buf;
+	size_t		 len;
+	size_t		 size;
+
+#define SEARCH_TEXT_ONLY 0x1
+	int		 flags;
+
+	u_int		*px;
+	u_int		*py;
+};
+
 /* Environment variable. */
 struct environ_entry {
 	char		*name;
@@ -1093,6 +1248,11 @@ struct session {
 
 	struct options	 options;
 
+	/* Window list built from the cached winlink entries. */
+	struct screen	*status_list;
+	u_int		 status_list_count;
+	u_int		 status_list_offset;
+
 #define SESSION_UNATTACHED 0x1	/* not attached to any clients */
 	int		 flags;
 
@@ -1222,6 +1382,10 @@ struct tty {
 
 	struct event	 key_timer;
 	struct tty_key	*key_tree;
+	struct timeval	 key_time;	/* when the last key was read */
+
+	unsigned long long bytes;	/* written to the terminal */
+	u_int		 redraws;
 };
 
 /* TTY command context and function pointer. */
@@ -1254,21 +1418,80 @@ struct tty_ctx {
 	u_int		 last_width;
 };
 
+/* Latency histogram, see latency.c. */
+#define LATENCY_BUCKETS 100
+#define LATENCY_MAXIMUM 60
+struct latency {
+	u_int		 buckets[LATENCY_BUCKETS];
+	u_int		 count;
+	u_int		 maximum;
+};
+
+/* Server statistics, see stats.c. */
+enum stats_type {
+	STATS_CLIENT,	/* commands and keys from clients */
+	STATS_PANE,	/* reading and parsing pane output */
+	STATS_JOB,	/* job callbacks */
+	STATS_REDRAW,	/* checking for and redrawing changes */
+	STATS_TIMER	/* the once a second timer */
+};
+#define STATS_TYPES 5
+struct stats {
+	unsigned long long loops;
+	unsigned long long pane_bytes;
+	unsigned long long input_bytes;
+	unsigned long long input_cells;
+	unsigned long long tty_bytes;
+	unsigned long long redraws;
+	unsigned long long format_expands;
+	unsigned long long job_forks;
+
+	unsigned long long calls[STATS_TYPES];
+	unsigned long long time[STATS_TYPES];	/* in microseconds */
+};
+
 /* Saved message entry. */
 struct message_entry {
 	char   *msg;
 	time_t	msg_time;
 };
 
-/* Status output data from a job. */
+/*
+ * Status output data from a job. One of these exists for each #() command,
+ * shared by every client and session using it.
+ */
 struct status_out {
-	char   *cmd;
-	char   *out;
+	char		*cmd;
+	char		*out;
+
+	struct job	*job;		/* running job, if any */
+	struct timeval	 start;		/* when the last job was started */
+	time_t		 used;		/* when the output was last wanted */
+	int		 interval;	/* status-interval when last wanted */
+
+	u_int		 runs;
+	u_int		 failures;
+	u_int		 latency;	/* last run time in milliseconds */
 
 	RB_ENTRY(status_out) entry;
 };
 RB_HEAD(status_out_tree, status_out);
 
+/* Control mode client state for a pane. */
+struct control_pane {
+	u_int		 pane;
+
+	int		 flags;
+#define CONTROL_PANE_PAUSED 0x1
+#define CONTROL_PANE_ON 0x2
+#define CONTROL_PANE_OFF 0x4
+
+	struct evbuffer	*pending;	/* waiting for the output timer */
+
+	RB_ENTRY(control_pane) entry;
+};
+RB_HEAD(control_panes, control_pane);
+
 /* Client connection. */
 struct client {
 	struct imsgbuf	 ibuf;
@@ -1289,16 +1512,24 @@ struct client {
 	void		*stdin_callback_data;
 	struct evbuffer	*stdin_data;
 	int              stdin_closed;
+	int		 stdin_fd;
+	struct event	 stdin_event;
 	struct evbuffer	*stdout_data;
 	struct evbuffer	*stderr_data;
 
 	struct event	 repeat_timer;
 
-	struct status_out_tree status_old;
-	struct status_out_tree status_new;
 	struct timeval	 status_timer;
 	struct screen	 status;
 
+	/*
+	 * Time the last key sent to a pane was read and the pane it was sent
+	 * to, until output from that pane is next written to the client.
+	 */
+	struct timeval	 key_time;
+	u_int		 key_pane;
+	struct latency	 key_latency;
+
 #define CLIENT_TERMINAL 0x1
 #define CLIENT_PREFIX 0x2
 #define CLIENT_EXIT 0x4
@@ -1313,6 +1544,9 @@ struct client {
 #define CLIENT_READONLY 0x800
 #define CLIENT_REDRAWWINDOW 0x1000
 #define CLIENT_CONTROL 0x2000
+#define CLIENT_CONTROLCOMPACT 0x4000
+#define CLIENT_CONTROLNOOUTPUT 0x8000
+#define CLIENT_BATCH 0x10000
 	int		 flags;
 
 	struct event	 identify_timer;
@@ -1339,6 +1573,14 @@ struct client {
 
 	int		 wlmouse;
 
+	struct control_panes control_panes;
+	u_int		 control_rate;	/* milliseconds between output */
+	struct event	 control_timer;
+
+	u_int		 batch_line;	/* lines read */
+	u_int		 batch_id;	/* line of running command or 0 */
+	int		 batch_retcode;
+
 	int		 references;
 };
 ARRAY_DECL(clients, struct client *);
@@ -1488,6 +1730,7 @@ extern struct environ global_environ;
 extern struct event_base *ev_base;
 extern char	*cfg_file;
 extern char	*shell_cmd;
+extern char	*batch_file;
 extern int	 debug_level;
 extern time_t	 start_time;
 extern char	 socket_path[MAXPATHLEN];
@@ -1549,7 +1792,7 @@ enum mode_key_cmd mode_key_lookup(struct mode_key_data *, int);
 /* notify.c */
 void	notify_enable(void);
 void	notify_disable(void);
-void	notify_input(struct window_pane *, struct evbuffer *);
+void	notify_input(struct window_pane *, u_char *, size_t);
 void	notify_window_layout_changed(struct window *);
 void	notify_window_unlinked(struct session *, struct window *);
 void	notify_window_linked(struct session *, struct window *);
@@ -1578,6 +1821,7 @@ long long options_get_number(struct options *, const char *);
 extern const struct options_table_entry server_options_table[];
 extern const struct options_table_entry session_options_table[];
 extern const struct options_table_entry window_options_table[];
+extern const char *options_table_pipe_pane_policy_list[];
 void	options_table_populate_tree(
 	    const struct options_table_entry *, struct options *);
 const char *options_table_print_entry(
@@ -1604,7 +1848,8 @@ void	environ_set(struct environ *, const char *, const char *);
 void	environ_put(struct environ *, const char *);
 void	environ_unset(struct environ *, const char *);
 void	environ_update(const char *, struct environ *, struct environ *);
-void	environ_push(struct environ *);
+char  **environ_array(struct environ *);
+void	environ_free_array(char **);
 
 /* tty.c */
 void	tty_init_termios(int, struct termios *, struct bufferevent *);
@@ -1785,15 +2030,18 @@ extern const struct cmd_entry cmd_paste_buffer_entry;
 extern const struct cmd_entry cmd_pipe_pane_entry;
 extern const struct cmd_entry cmd_previous_layout_entry;
 extern const struct cmd_entry cmd_previous_window_entry;
+extern const struct cmd_entry cmd_record_pane_entry;
 extern const struct cmd_entry cmd_refresh_client_entry;
 extern const struct cmd_entry cmd_rename_session_entry;
 extern const struct cmd_entry cmd_rename_window_entry;
+extern const struct cmd_entry cmd_replay_pane_entry;
 extern const struct cmd_entry cmd_resize_pane_entry;
 extern const struct cmd_entry cmd_respawn_pane_entry;
 extern const struct cmd_entry cmd_respawn_window_entry;
 extern const struct cmd_entry cmd_rotate_window_entry;
 extern const struct cmd_entry cmd_run_shell_entry;
 extern const struct cmd_entry cmd_save_buffer_entry;
+extern const struct cmd_entry cmd_search_panes_entry;
 extern const struct cmd_entry cmd_select_layout_entry;
 extern const struct cmd_entry cmd_select_pane_entry;
 extern const struct cmd_entry cmd_select_window_entry;
@@ -1808,6 +2056,7 @@ extern const struct cmd_entry cmd_show_buffer_entry;
 extern const struct cmd_entry cmd_show_environment_entry;
 extern const struct cmd_entry cmd_show_messages_entry;
 extern const struct cmd_entry cmd_show_options_entry;
+extern const struct cmd_entry cmd_show_stats_entry;
 extern const struct cmd_entry cmd_show_window_options_entry;
 extern const struct cmd_entry cmd_source_file_entry;
 extern const struct cmd_entry cmd_split_window_entry;
@@ -1850,6 +2099,17 @@ void printflike2 key_bindings_info(struct cmd_ctx *, const char *, ...);
 int	 key_string_lookup_string(const char *);
 const char *key_string_lookup_key(int);
 
+/* stats.c */
+extern struct stats global_stats;
+extern const char *stats_type_names[];
+void	 stats_start(struct timeval *);
+void	 stats_stop(enum stats_type, struct timeval *);
+void	 stats_timer(void);
+
+/* latency.c */
+void	 latency_add(struct latency *, struct timeval *, struct timeval *);
+u_int	 latency_percentile(struct latency *, u_int);
+
 /* server.c */
 extern struct clients clients;
 extern struct clients dead_clients;
@@ -1860,6 +2120,7 @@ void	 server_add_accept(int);
 
 /* server-client.c */
 void	 server_client_handle_key(struct client *, int);
+void	 server_client_key_echo(struct window_pane *);
 void	 server_client_create(int);
 int      server_client_open(struct client *, struct session *, char **);
 void	 server_client_lost(struct client *);
@@ -1903,15 +2164,20 @@ void	 server_clear_identify(struct client *);
 void	 server_update_event(struct client *);
 void	 server_push_stdout(struct client *);
 void	 server_push_stderr(struct client *);
+int	 server_stdout_pipe(struct client *);
 int	 server_set_stdin_callback(struct client *, void (*)(struct client *,
 	     int, void *), void *, char **);
 
 /* status.c */
+extern struct status_out_tree status_jobs;
 int	 status_out_cmp(struct status_out *, struct status_out *);
 RB_PROTOTYPE(status_out_tree, status_out, entry, status_out_cmp);
 int	 status_at_line(struct client *);
-void	 status_free_jobs(struct status_out_tree *);
-void	 status_update_jobs(struct client *);
+void	 status_invalidate_all(void);
+void	 status_invalidate_window(struct window *);
+void	 status_invalidate_session(struct session *, time_t);
+void	 status_update_jobs(void);
+void	 status_expire_jobs(time_t);
 void	 status_set_window_at(struct client *, u_int);
 int	 status_redraw(struct client *);
 char	*status_replace(struct client *, struct session *,
@@ -1929,10 +2195,31 @@ void	 status_prompt_update(struct client *, const char *, const char *);
 /* resize.c */
 void	 recalculate_sizes(void);
 
+/* pipe.c */
+struct pane_pipe *pipe_find(struct window_pane *, const char *);
+struct pane_pipe *pipe_open(struct window_pane *, const char *, const char *,
+	     int, int);
+void	 pipe_close(struct pane_pipe *);
+void	 pipe_close_all(struct window_pane *);
+void	 pipe_write(struct window_pane *, u_char *, size_t);
+unsigned long long pipe_dropped(struct window_pane *);
+
+/* record.c */
+#define REPLAY_FAST 0x1
+int	 record_start(struct window_pane *, const char *, char **);
+void	 record_stop(struct window_pane *);
+void	 record_data(struct window_pane *, const u_char *, size_t);
+void	 record_resize(struct window_pane *);
+int	 record_next(const u_char *, size_t, size_t *, struct record_entry *);
+void	 record_get_size(struct record_entry *, u_int *, u_int *);
+int	 replay_start(struct window_pane *, u_char *, size_t, int, char **);
+void	 replay_stop(struct window_pane *);
+
 /* input.c */
 void	 input_init(struct window_pane *);
 void	 input_free(struct window_pane *);
-void	 input_parse(struct window_pane *);
+int	 input_parse(struct window_pane *);
+void	 input_parse_buffer(struct window_pane *, u_char *, size_t);
 
 /* input-key.c */
 void	 input_key(struct window_pane *, int);
@@ -1951,6 +2238,14 @@ int	 colour_fromstring(const char *);
 u_char	 colour_256to16(u_char);
 u_char	 colour_256to88(u_char);
 
+/* content.c */
+int		 content_check(const char *, char **);
+struct content	*content_create(const char *);
+void		 content_free(struct content *);
+void		 content_cell(struct window_pane *, u_int, u_int,
+		     const struct grid_cell *, const struct utf8_data *);
+void		 content_linefeed(struct window_pane *, int);
+
 /* attributes.c */
 const char *attributes_tostring(u_char);
 int	 attributes_fromstring(const char *);
@@ -1977,8 +2272,23 @@ void	 grid_clear_lines(struct grid *, u_int, u_int);
 void	 grid_move_lines(struct grid *, u_int, u_int, u_int);
 void	 grid_move_cells(struct grid *, u_int, u_int, u_int, u_int);
 char	*grid_string_cells(struct grid *, u_int, u_int, u_int);
+void	 grid_string_line(struct grid *, u_int, u_int, struct evbuffer *,
+	     struct grid_cell *);
+void	 grid_string_code(const struct grid_cell *, struct grid_cell *,
+	     struct evbuffer *);
 void	 grid_duplicate_lines(
 	     struct grid *, u_int, struct grid *, u_int, u_int);
+void	 grid_clear_history(struct grid *);
+
+/* grid-index.c */
+void	 grid_index_set(struct grid *, size_t);
+void	 grid_index_free(struct grid *);
+void	 grid_index_update(struct grid *);
+void	 grid_index_remove(struct grid *, u_int);
+void	 grid_index_truncate(struct grid *);
+int	 grid_index_lookup(struct grid *, struct search *,
+	     struct grid_index_ranges *, u_int *, u_int *);
+size_t	 grid_index_size(struct grid *);
 
 /* grid-utf8.c */
 size_t	 grid_utf8_size(const struct grid_utf8 *);
@@ -2069,6 +2379,7 @@ void	 screen_write_bracketpaste(struct screen_write_ctx *, int);
 /* screen-redraw.c */
 void	 screen_redraw_screen(struct client *, int, int);
 void	 screen_redraw_pane(struct client *, struct window_pane *);
+void	 screen_redraw_invalidate(struct window *);
 
 /* screen.c */
 void	 screen_init(struct screen *, u_int, u_int, u_int);
@@ -2148,8 +2459,9 @@ void		 window_pane_key(struct window_pane *, struct session *, int);
 void		 window_pane_mouse(struct window_pane *,
 		     struct session *, struct mouse_event *);
 int		 window_pane_visible(struct window_pane *);
-char		*window_pane_search(
-		     struct window_pane *, const char *, u_int *);
+void		 window_pane_update_index(struct window_pane *);
+void		 window_pane_update_read(struct window_pane *);
+char		*window_pane_find(struct window_pane *, struct search *, u_int *);
 char		*window_printable_flags(struct session *, struct winlink *);
 struct window_pane *window_pane_find_up(struct window_pane *);
 struct window_pane *window_pane_find_down(struct window_pane *);
@@ -2157,6 +2469,7 @@ struct window_pane *window_pane_find_left(struct window_pane *);
 struct window_pane *window_pane_find_right(struct window_pane *);
 void		 window_set_name(struct window *, const char *);
 void		 window_remove_ref(struct window *);
+void		 window_update_content(struct window *);
 void		 winlink_clear_flags(struct winlink *);
 void		 window_mode_attrs(struct grid_cell *, struct options *);
 
@@ -2217,6 +2530,10 @@ void		 window_choose_add(struct window_pane *,
 void		 window_choose_ready(struct window_pane *,
 		     u_int, void (*)(struct window_choose_data *),
 		     void (*)(struct window_choose_data *));
+void		 window_choose_append(struct window_pane *,
+		     struct window_choose_data *);
+void		 window_choose_background(struct window_pane *,
+		     void (*)(void *), void *);
 struct window_choose_data	*window_choose_data_create(struct cmd_ctx *);
 void		 window_choose_ctx(struct window_choose_data *);
 struct window_choose_data	*window_choose_add_window(struct window_pane *,
@@ -2234,6 +2551,11 @@ void	window_choose_expand_all(struct window_pane *);
 void		 queue_window_name(struct window *);
 char		*default_window_name(struct window *);
 
+/* spawn.c */
+pid_t	spawn_process(struct spawn *);
+pid_t	spawn_pane(struct spawn *, int *, char *, struct winsize *,
+	    const struct termios *, int);
+
 /* signal.c */
 void	set_signals(void(*)(int, short, void *));
 void	clear_signals(int);
@@ -2242,10 +2564,29 @@ void	clear_signals(int);
 void	control_callback(struct client *, int, void*);
 void printflike2 control_write(struct client *, const char *, ...);
 void	control_write_buffer(struct client *, struct evbuffer *);
+void	control_encode_output(struct evbuffer *, const u_char *, size_t,
+	    int);
+int	control_check_output(struct client *, struct window_pane *);
+void	control_write_output(struct client *, struct window_pane *,
+	    const u_char *, size_t);
+void	control_write_encoded(struct client *, struct window_pane *,
+	    struct evbuffer *);
+int	control_set_flags(struct client *, const char *, char **);
+int	control_pane_cmp(struct control_pane *, struct control_pane *);
+RB_PROTOTYPE(control_panes, control_pane, entry, control_pane_cmp);
+struct control_pane *control_get_pane(struct client *, struct window_pane *);
+void	control_free(struct client *);
+void	control_remove_pane(struct window_pane *);
+void	control_pause_pane(struct client *, struct window_pane *);
+void	control_continue_pane(struct client *, struct window_pane *);
+void	control_set_pane(struct client *, struct window_pane *, int);
+int	control_want_output(struct client *, struct window_pane *);
+void	control_queue_output(struct client *, struct window_pane *,
+	    const u_char *, size_t);
 
 /* control-notify.c */
 void	control_notify_input(struct client *, struct window_pane *,
-	    struct evbuffer *);
+	    u_char *, size_t, struct evbuffer **);
 void	control_notify_window_layout_changed(struct window *);
 void	control_notify_window_unlinked(struct session *, struct window *);
 void	control_notify_window_linked(struct session *, struct window *);
@@ -2255,6 +2596,18 @@ void	control_notify_session_renamed(struct session *);
 void	control_notify_session_created(struct session *);
 void	control_notify_session_close(struct session *);
 
+/* search.c */
+int	 search_compile(struct search *, const char *, int, char **);
+void	 search_free(struct search *);
+int	 search_find(struct search *, const char *, size_t, size_t, size_t *,
+	     size_t *);
+char	*search_glob(const char *);
+void	 search_text_init(struct search_text *);
+void	 search_text_free(struct search_text *);
+u_int	 search_text_line(struct search_text *, struct grid *, u_int);
+void	 search_grid(struct search *, struct grid *,
+	     int (*)(struct search_text *, size_t, size_t, void *), void *);
+
 /* session.c */
 extern struct sessions sessions;
 extern struct sessions dead_sessions;
@@ -0,0 +1,305 @@
+/* $Id$ */
+
+/*
+ * Replay recorded terminal output through the pane input parser and the tty
+ * drawing code with no server, client process or real terminal, and report
+ * how fast it goes. Each file is fed to a single full-size pane in read-sized
+ * chunks, with the redraws the server would do after each loop, and the tty
+ * output is thrown away.
+ *
+ * Build and run with: make bench
+ * Usage: bench [-n count] [-r size] [-T term] [-x width] [-y height] file ...
+ *
+ * The recordings in tools/corpus were made at 80x24 with TERM=xterm-256color,
+ * for example with: script -c 'vim tmux.c' vim.out
+ * Files made by record-pane may also be used.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <err.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tmux.h"
+
+/*
+ * The globals and helpers in tmux.c are needed but not its main, so it is
+ * built in here with main renamed.
+ */
+int	tmux_main(int, char **);
+#define main tmux_main
+#include "tmux.c"
+#undef main
+
+struct bench {
+	const char	*name;
+	u_char		*buf;
+	size_t		 len;
+
+	double		 secs;
+	unsigned long long bytes;
+	unsigned long long cells;
+	unsigned long long tty_bytes;
+};
+
+struct client	*bench_client(u_int, u_int, const char *);
+void		 bench_load(struct bench *, const char *);
+void		 bench_run(struct bench *, struct window_pane *, struct client *,
+		     u_int, size_t);
+void		 bench_print(struct bench *);
+double		 bench_now(void);
+
+/* Make a client on a new pty with a session showing one window and pane. */
+struct client *
+bench_client(u_int sx, u_int sy, const char *term)
+{
+	struct client	*c;
+	struct session	*s;
+	struct winlink	*wl;
+	struct window	*w;
+	struct winsize	 ws;
+	char		*cause;
+	int		 master, slave;
+
+	memset(&ws, 0, sizeof ws);
+	ws.ws_col = sx;
+	ws.ws_row = sy;
+	if (openpty(&master, &slave, NULL, NULL, &ws) != 0)
+		err(1, "openpty");
+
+	w = window_create1(sx, sy);
+	w->active = window_add_pane(w, 2000);
+	w->active->event = bufferevent_new(-1, NULL, NULL, NULL, NULL);
+#ifdef LIBEVENT_VERSION_NUMBER
+	/* Input is added directly rather than read, so allow it. */
+	evbuffer_unfreeze(w->active->event->input, 0);
+#endif
+
+	wl = xcalloc(1, sizeof *wl);
+	wl->window = w;
+
+	s = xcalloc(1, sizeof *s);
+	s->name = xstrdup("bench");
+	options_init(&s->options, &global_s_options);
+	s->curw = wl;
+
+	c = xcalloc(1, sizeof *c);
+	c->session = s;
+	c->stdin_data = evbuffer_new();
+	c->stdout_data = evbuffer_new();
+	c->stderr_data = evbuffer_new();
+	tty_init(&c->tty, c, slave, xstrdup(term));
+	if (tty_open(&c->tty, "", &cause) != 0)
+		errx(1, "%s", cause);
+	tty_resize(&c->tty);
+	ARRAY_ADD(&clients, c);
+
+	return (c);
+}
+
+/* Read a file into memory. */
+void
+bench_load(struct bench *b, const char *path)
+{
+	struct stat		sb;
+	struct record_entry	re;
+	u_char		       *buf;
+	size_t			len, off;
+	ssize_t			n;
+	int			fd, ret;
+
+	memset(b, 0, sizeof *b);
+	if ((b->name = strrchr(path, '/')) != NULL)
+		b->name++;
+	else
+		b->name = path;
+
+	if ((fd = open(path, O_RDONLY)) == -1 || fstat(fd, &sb) != 0)
+		err(1, "%s", path);
+	if (sb.st_size == 0)
+		errx(1, "%s: empty file", path);
+	b->len = sb.st_size;
+	b->buf = xmalloc(b->len);
+	if ((n = read(fd, b->buf, b->len)) == -1)
+		err(1, "%s", path);
+	if ((size_t) n != b->len)
+		errx(1, "%s: short read", path);
+	close(fd);
+
+	/* Take just the data from recordings made with record-pane. */
+	if (b->len >= RECORD_MAGICLEN &&
+	    memcmp(b->buf, RECORD_MAGIC, RECORD_MAGICLEN) == 0) {
+		buf = xmalloc(b->len);
+		len = off = 0;
+		while ((ret = record_next(b->buf, b->len, &off, &re)) == 1) {
+			if (re.type != RECORD_DATA)
+				continue;
+			memcpy(buf + len, re.data, re.size);
+			len += re.size;
+		}
+		if (ret != 0 || len == 0)
+			errx(1, "%s: bad recording", path);
+		free(b->buf);
+		b->buf = buf;
+		b->len = len;
+	}
+}
+
+/* Replay a file count times, size bytes at a time. */
+void
+bench_run(struct bench *b, struct window_pane *wp, struct client *c,
+    u_int count, size_t size)
+{
+	struct evbuffer		*out = c->tty.event->output;
+	struct stats		 st;
+	size_t			 off, n;
+	u_int			 i;
+	double			 start;
+
+	/* Start from a clean screen and terminal each time. */
+	evbuffer_add(wp->event->input, "\033c", 2);
+	input_parse(wp);
+	server_redraw_window(wp->window);
+	server_client_loop();
+	evbuffer_drain(out, EVBUFFER_LENGTH(out));
+
+	memcpy(&st, &global_stats, sizeof st);
+	start = bench_now();
+	for (i = 0; i < count; i++) {
+		for (off = 0; off < b->len; off += n) {
+			n = b->len - off;
+			if (n > size)
+				n = size;
+			evbuffer_add(wp->event->input, b->buf + off, n);
+			while (input_parse(wp))
+				/* nothing */;
+			server_client_loop();
+			evbuffer_drain(out, EVBUFFER_LENGTH(out));
+		}
+	}
+	b->secs = bench_now() - start;
+
+	b->bytes = global_stats.input_bytes - st.input_bytes;
+	b->cells = global_stats.input_cells - st.input_cells;
+	b->tty_bytes = global_stats.tty_bytes - st.tty_bytes;
+}
+
+void
+bench_print(struct bench *b)
+{
+	double	secs = b->secs;
+
+	if (secs <= 0)
+		secs = 1e-6;
+	printf("%-16s %10.2f %12.0f %10.3f %10.3f\n", b->name,
+	    b->bytes / secs / 1048576, b->cells / secs,
+	    (double) b->tty_bytes / b->bytes, secs);
+}
+
+double
+bench_now(void)
+{
+	struct timeval	tv;
+
+	if (gettimeofday(&tv, NULL) != 0)
+		err(1, "gettimeofday");
+	return (tv.tv_sec + tv.tv_usec / 1000000.0);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct client	*c;
+	struct bench	*benches, total;
+	const char	*term = "xterm-256color", *errstr;
+	u_int		 count = 10, sx = 80, sy = 24;
+	size_t		 size = 4096;
+	int		 ch, i;
+
+	while ((ch = getopt(argc, argv, "n:r:T:x:y:")) != -1) {
+		switch (ch) {
+		case 'n':
+			count = strtonum(optarg, 1, 100000, &errstr);
+			if (errstr != NULL)
+				errx(1, "count %s", errstr);
+			break;
+		case 'r':
+			size = strtonum(optarg, 1, 1048576, &errstr);
+			if (errstr != NULL)
+				errx(1, "size %s", errstr);
+			break;
+		case 'T':
+			term = optarg;
+			break;
+		case 'x':
+			sx = strtonum(optarg, PANE_MINIMUM, 10000, &errstr);
+			if (errstr != NULL)
+				errx(1, "width %s", errstr);
+			break;
+		case 'y':
+			sy = strtonum(optarg, PANE_MINIMUM, 10000, &errstr);
+			if (errstr != NULL)
+				errx(1, "height %s", errstr);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc == 0)
+		goto usage;
+
+	ev_base = event_init();
+
+	environ_init(&global_environ);
+	options_init(&global_options, NULL);
+	options_table_populate_tree(server_options_table, &global_options);
+	options_init(&global_s_options, NULL);
+	options_table_populate_tree(session_options_table, &global_s_options);
+	options_init(&global_w_options, NULL);
+	options_table_populate_tree(window_options_table, &global_w_options);
+
+	/*
+	 * No status line, no renaming and no rate limiting: all the output
+	 * should reach the terminal so the numbers do not depend on timing.
+	 */
+	options_set_number(&global_s_options, "status", 0);
+	options_set_number(&global_w_options, "automatic-rename", 0);
+	options_set_number(&global_w_options, "c0-change-trigger", 0);
+	options_set_number(&global_w_options, "utf8", 1);
+
+	c = bench_client(sx, sy, term);
+
+	benches = xcalloc(argc, sizeof *benches);
+	memset(&total, 0, sizeof total);
+	total.name = "total";
+
+	printf("%-16s %10s %12s %10s %10s\n", "file", "MB/s", "cells/s",
+	    "tty/input", "seconds");
+	for (i = 0; i < argc; i++) {
+		bench_load(&benches[i], argv[i]);
+		bench_run(&benches[i], c->session->curw->window->active, c,
+		    count, size);
+		bench_print(&benches[i]);
+
+		total.secs += benches[i].secs;
+		total.bytes += benches[i].bytes;
+		total.cells += benches[i].cells;
+		total.tty_bytes += benches[i].tty_bytes;
+	}
+	if (argc > 1)
+		bench_print(&total);
+	return (0);
+
+usage:
+	fprintf(stderr, "usage: bench [-n count] [-r size] [-T term] "
+	    "[-x width] [-y height] file ...\n");
+	return (1);
+}
@@ -0,0 +1,190 @@
+/* $Id$ */
+
+/*
+ * Measure the time from a key being typed into an attached client to it being
+ * echoed back, while other panes in the same window flood output. The server
+ * is private, on a socket in a temporary directory.
+ *
+ * Build and run with: make bench-latency
+ * Usage: latency [-f flooders] [-n count] /path/to/tmux
+ */
+
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include <err.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <pty.h>
+#else
+#include <util.h>
+#endif
+
+const char	*tmux;
+char		 dir[] = "/tmp/tmux-latency-XXXXXX";
+char		 socket_path[PATH_MAX];
+
+void	cleanup(void);
+void	run(const char *);
+void	drain(int, int);
+double	now(void);
+int	cmp(const void *, const void *);
+
+/* Kill the server and remove its socket, even if something failed. */
+void
+cleanup(void)
+{
+	char	buf[PATH_MAX * 2 + 64];
+
+	snprintf(buf, sizeof buf, "%s -S%s kill-server 2>/dev/null", tmux,
+	    socket_path);
+	system(buf);
+
+	while (wait(NULL) != -1)
+		/* nothing */;
+	unlink(socket_path);
+	rmdir(dir);
+}
+
+void
+run(const char *cmd)
+{
+	char	buf[PATH_MAX * 2 + 1024];
+
+	snprintf(buf, sizeof buf, "%s -S%s -f/dev/null %s", tmux, socket_path,
+	    cmd);
+	if (system(buf) != 0)
+		errx(1, "%s failed", buf);
+}
+
+void
+drain(int fd, int ms)
+{
+	struct pollfd	pfd;
+	char		buf[65536];
+	double		end;
+
+	end = now() + ms;
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	while (now() < end) {
+		if (poll(&pfd, 1, 10) == 1 && read(fd, buf, sizeof buf) <= 0)
+			return;
+	}
+}
+
+double
+now(void)
+{
+	struct timeval	tv;
+
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0);
+}
+
+int
+cmp(const void *a, const void *b)
+{
+	double	da = *(const double *) a, db = *(const double *) b;
+
+	return (da < db ? -1 : da > db);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct winsize	ws;
+	struct pollfd	pfd;
+	char		buf[65536];
+	double	       *times, start;
+	int		ch, i, fd, flooders = 3, count = 100;
+	ssize_t		n;
+	pid_t		pid;
+
+	while ((ch = getopt(argc, argv, "f:n:")) != -1) {
+		switch (ch) {
+		case 'f':
+			flooders = atoi(optarg);
+			break;
+		case 'n':
+			count = atoi(optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 1 || count < 1)
+		goto usage;
+	tmux = argv[0];
+	if ((times = calloc(count, sizeof *times)) == NULL)
+		err(1, "calloc");
+
+	if (mkdtemp(dir) == NULL)
+		err(1, "mkdtemp");
+	snprintf(socket_path, sizeof socket_path, "%s/socket", dir);
+	atexit(cleanup);
+
+	/* One pane echoing with cat, the others running yes. */
+	run("new -d -x160 -y50 cat");
+	for (i = 0; i < flooders; i++)
+		run("splitw -dh yes \\; selectl even-h >/dev/null");
+	run("set -g status off >/dev/null");
+
+	memset(&ws, 0, sizeof ws);
+	ws.ws_col = 160;
+	ws.ws_row = 50;
+	if ((pid = forkpty(&fd, NULL, NULL, &ws)) == -1)
+		err(1, "forkpty");
+	if (pid == 0) {
+		setenv("TERM", "xterm", 1);
+		execl(tmux, tmux, "-S", socket_path, "-f/dev/null", "attach",
+		    NULL);
+		_exit(1);
+	}
+	drain(fd, 1000);
+
+	/* Type Z and wait for it to come back. yes never prints a Z. */
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	for (i = 0; i < count; i++) {
+		start = now();
+		if (write(fd, "Z", 1) != 1)
+			err(1, "write");
+		for (;;) {
+			if (poll(&pfd, 1, 5000) != 1)
+				errx(1, "timed out");
+			if ((n = read(fd, buf, sizeof buf)) <= 0)
+				errx(1, "client exited");
+			if (memchr(buf, 'Z', n) != NULL)
+				break;
+		}
+		times[i] = now() - start;
+		drain(fd, 20);
+	}
+
+	run("kill-server");
+	waitpid(pid, NULL, 0);
+
+	qsort(times, count, sizeof *times, cmp);
+	printf("%d keys, %d flooding panes: "
+	    "p50 %.2fms p90 %.2fms p99 %.2fms max %.2fms\n", count, flooders,
+	    times[count / 2], times[count * 90 / 100], times[count * 99 / 100],
+	    times[count - 1]);
+	return (0);
+
+usage:
+	fprintf(stderr, "usage: latency [-f flooders] [-n count] tmux\n");
+	return (1);
+}
@@ -0,0 +1,430 @@
+/* $Id$ */
+
+/*
+ * Start a private server with many sessions, windows and panes, each pane
+ * running a small output generator, attach some clients and measure the
+ * server's idle CPU use, memory per pane and how long commands take to run.
+ * Linux only, as the server's usage is read from /proc.
+ *
+ * Build and run with: make bench-scale
+ * Usage: scale [-c clients] [-i interval] [-n count] [-p panes] [-s sessions]
+ *              [-t seconds] [-w windows] /path/to/tmux
+ */
+
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include <err.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <pty.h>
+#else
+#include <util.h>
+#endif
+
+#define WIDTH 160
+#define HEIGHT 50
+
+const char	*tmux;
+char		 dir[] = "/tmp/tmux-scale-XXXXXX";
+char		 socket_path[PATH_MAX];
+char		 self[PATH_MAX];
+
+int		*clients;
+int		 nclients;
+
+void		cleanup(void);
+void		generate(int);
+void		run(const char *, ...);
+double		command(const char *, ...);
+void		drain(int);
+void		wait_for(int);
+long		server_pid(void);
+void		server_usage(long, unsigned long long *, unsigned long long *);
+double		now(void);
+int		cmp(const void *, const void *);
+void		report(const char *, double *, int);
+
+/* Kill the server and remove its socket, even if something failed. */
+void
+cleanup(void)
+{
+	char	buf[PATH_MAX * 2 + 64];
+	int	i;
+
+	snprintf(buf, sizeof buf, "%s -S%s kill-server 2>/dev/null", tmux,
+	    socket_path);
+	system(buf);
+
+	for (i = 0; i < nclients; i++)
+		close(clients[i]);
+	while (wait(NULL) != -1)
+		/* nothing */;
+	unlink(socket_path);
+	rmdir(dir);
+}
+
+/* Print a line every interval milliseconds, or nothing if zero. */
+void
+generate(int interval)
+{
+	struct timespec	ts;
+	unsigned long	n;
+
+	if (interval == 0) {
+		for (;;)
+			pause();
+	}
+
+	ts.tv_sec = interval / 1000;
+	ts.tv_nsec = (interval % 1000) * 1000000L;
+	for (n = 0;; n++) {
+		printf("%lu \033[1;3%lumline %lu of synthetic output\033[m\n",
+		    n, n % 8, n);
+		fflush(stdout);
+		nanosleep(&ts, NULL);
+	}
+}
+
+/* Run a tmux command through the shell, failing if it fails. */
+void
+run(const char *fmt, ...)
+{
+	va_list	ap;
+	char	cmd[8192], buf[8192 + PATH_MAX * 2];
+
+	va_start(ap, fmt);
+	vsnprintf(cmd, sizeof cmd, fmt, ap);
+	va_end(ap);
+
+	snprintf(buf, sizeof buf, "%s -S%s -f/dev/null %s >/dev/null", tmux,
+	    socket_path, cmd);
+	if (system(buf) != 0)
+		errx(1, "%s failed", buf);
+}
+
+/*
+ * Run a tmux command directly and return how long it took in milliseconds.
+ * The clients are drained while waiting so the server never blocks on them.
+ */
+double
+command(const char *first, ...)
+{
+	va_list	 ap;
+	char	*argv[16];
+	int	 argc, status, fd;
+	double	 start;
+	pid_t	 pid;
+
+	argc = 0;
+	argv[argc++] = (char *) tmux;
+	argv[argc++] = (char *) "-S";
+	argv[argc++] = socket_path;
+	argv[argc++] = (char *) first;
+	va_start(ap, first);
+	while (argc < 15 && (argv[argc] = va_arg(ap, char *)) != NULL)
+		argc++;
+	va_end(ap);
+	argv[argc] = NULL;
+
+	start = now();
+	switch (pid = fork()) {
+	case -1:
+		err(1, "fork");
+	case 0:
+		if ((fd = open("/dev/null", O_WRONLY)) != -1)
+			dup2(fd, STDOUT_FILENO);
+		execv(tmux, argv);
+		_exit(1);
+	}
+	while (waitpid(pid, &status, WNOHANG) == 0)
+		drain(1);
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		errx(1, "%s failed", first);
+	return (now() - start);
+}
+
+/* Read whatever the clients have been sent, waiting up to ms. */
+void
+drain(int ms)
+{
+	struct pollfd	*pfds;
+	char		 buf[65536];
+	int		 i;
+
+	if (nclients == 0) {
+		usleep(ms * 1000);
+		return;
+	}
+
+	if ((pfds = calloc(nclients, sizeof *pfds)) == NULL)
+		err(1, "calloc");
+	for (i = 0; i < nclients; i++) {
+		pfds[i].fd = clients[i];
+		pfds[i].events = POLLIN;
+	}
+	if (poll(pfds, nclients, ms) > 0) {
+		for (i = 0; i < nclients; i++) {
+			if (pfds[i].revents & (POLLIN|POLLHUP))
+				read(clients[i], buf, sizeof buf);
+		}
+	}
+	free(pfds);
+}
+
+/* Keep draining the clients for ms. */
+void
+wait_for(int ms)
+{
+	double	end;
+
+	end = now() + ms;
+	while (now() < end)
+		drain(10);
+}
+
+/* Find the server: it is the parent of the first pane. */
+long
+server_pid(void)
+{
+	FILE	*f;
+	char	 cmd[PATH_MAX * 2 + 64], path[64], state;
+	long	 pane, pid, ppid;
+
+	snprintf(cmd, sizeof cmd, "%s -S%s list-panes -t s0 -F '#{pane_pid}'",
+	    tmux, socket_path);
+	if ((f = popen(cmd, "r")) == NULL || fscanf(f, "%ld", &pane) != 1)
+		errx(1, "can't get pane pid");
+	pclose(f);
+
+	snprintf(path, sizeof path, "/proc/%ld/stat", pane);
+	if ((f = fopen(path, "r")) == NULL)
+		err(1, "%s", path);
+	if (fscanf(f, "%ld %*s %c %ld", &pid, &state, &ppid) != 3)
+		errx(1, "%s: bad format", path);
+	fclose(f);
+	return (ppid);
+}
+
+/* Get the server's CPU time in clock ticks and resident size in kilobytes. */
+void
+server_usage(long pid, unsigned long long *ticks, unsigned long long *rss)
+{
+	FILE			*f;
+	char			 path[64], line[256], *cp;
+	unsigned long long	 utime, stime;
+
+	snprintf(path, sizeof path, "/proc/%ld/stat", pid);
+	if ((f = fopen(path, "r")) == NULL)
+		err(1, "%s", path);
+	if (fgets(line, sizeof line, f) == NULL ||
+	    (cp = strrchr(line, ')')) == NULL ||
+	    sscanf(cp + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu",
+	    &utime, &stime) != 2)
+		errx(1, "%s: bad format", path);
+	fclose(f);
+	*ticks = utime + stime;
+
+	snprintf(path, sizeof path, "/proc/%ld/status", pid);
+	if ((f = fopen(path, "r")) == NULL)
+		err(1, "%s", path);
+	*rss = 0;
+	while (fgets(line, sizeof line, f) != NULL) {
+		if (sscanf(line, "VmRSS: %llu", rss) == 1)
+			break;
+	}
+	fclose(f);
+}
+
+double
+now(void)
+{
+	struct timeval	tv;
+
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0);
+}
+
+int
+cmp(const void *a, const void *b)
+{
+	double	da = *(const double *) a, db = *(const double *) b;
+
+	return (da < db ? -1 : da > db);
+}
+
+void
+report(const char *name, double *times, int count)
+{
+	qsort(times, count, sizeof *times, cmp);
+	printf("%-14s p50 %.2fms p90 %.2fms p99 %.2fms max %.2fms\n", name,
+	    times[count / 2], times[count * 90 / 100], times[count * 99 / 100],
+	    times[count - 1]);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct winsize		 ws;
+	char			 target[64];
+	char			 gen[PATH_MAX + 32], cmd[8192];
+	double			*times[3];
+	unsigned long long	 ticks0, ticks1, rss0, rss1;
+	long			 pid, hz;
+	int			 ch, i, j, k, len, total, attach = 2;
+	int			 sessions = 4, windows = 4, panes = 4;
+	int			 interval = 1000, count = 50, seconds = 10;
+	ssize_t			 n;
+
+	while ((ch = getopt(argc, argv, "c:g:i:n:p:s:t:w:")) != -1) {
+		switch (ch) {
+		case 'c':
+			attach = atoi(optarg);
+			break;
+		case 'g':
+			generate(atoi(optarg));
+			return (0);
+		case 'i':
+			interval = atoi(optarg);
+			break;
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'p':
+			panes = atoi(optarg);
+			break;
+		case 's':
+			sessions = atoi(optarg);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'w':
+			windows = atoi(optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 1 || sessions < 1 || windows < 1 || panes < 1 ||
+	    attach < 0 || interval < 0 || count < 1 || seconds < 1)
+		goto usage;
+	if (attach > sessions)
+		attach = sessions;
+	tmux = argv[0];
+	total = sessions * windows * panes;
+
+	if ((n = readlink("/proc/self/exe", self, sizeof self - 1)) == -1)
+		err(1, "readlink");
+	self[n] = '\0';
+	snprintf(gen, sizeof gen, "'%s -g%d'", self, interval);
+
+	if (mkdtemp(dir) == NULL)
+		err(1, "mkdtemp");
+	snprintf(socket_path, sizeof socket_path, "%s/socket", dir);
+	atexit(cleanup);
+	signal(SIGPIPE, SIG_IGN);
+
+	/* Start with a single pane to get the base memory use. */
+	run("new -d -ss0 -x%d -y%d %s", WIDTH, HEIGHT, gen);
+	pid = server_pid();
+	wait_for(500);
+	server_usage(pid, &ticks0, &rss0);
+
+	/* Then build the rest, a window at a time. */
+	for (i = 0; i < sessions; i++) {
+		for (j = 0; j < windows; j++) {
+			if (i == 0 && j == 0)
+				len = snprintf(cmd, sizeof cmd, "has -ts0");
+			else if (j == 0) {
+				len = snprintf(cmd, sizeof cmd,
+				    "new -d -ss%d -x%d -y%d %s", i, WIDTH,
+				    HEIGHT, gen);
+			} else {
+				len = snprintf(cmd, sizeof cmd,
+				    "neww -d -ts%d:%d %s", i, j, gen);
+			}
+			for (k = 1; k < panes && len < (int) sizeof cmd; k++) {
+				len += snprintf(cmd + len, sizeof cmd - len,
+				    " \\; splitw -d -ts%d:%d %s"
+				    " \\; selectl -ts%d:%d tiled", i, j, gen,
+				    i, j);
+			}
+			if (len >= (int) sizeof cmd)
+				errx(1, "too many panes");
+			run("%s", cmd);
+		}
+	}
+
+	/* Attach the clients, one to each of the first sessions. */
+	if ((clients = calloc(attach + 1, sizeof *clients)) == NULL)
+		err(1, "calloc");
+	memset(&ws, 0, sizeof ws);
+	ws.ws_col = WIDTH;
+	ws.ws_row = HEIGHT + 1;
+	for (i = 0; i < attach; i++) {
+		snprintf(target, sizeof target, "s%d", i);
+		switch (forkpty(&clients[nclients++], NULL, NULL, &ws)) {
+		case -1:
+			err(1, "forkpty");
+		case 0:
+			setenv("TERM", "xterm", 1);
+			execl(tmux, tmux, "-S", socket_path, "attach", "-t",
+			    target, (char *) NULL);
+			_exit(1);
+		}
+	}
+
+	/* Let everything settle, then measure. */
+	wait_for(1000);
+	server_usage(pid, &ticks0, &rss1);
+	wait_for(seconds * 1000);
+	server_usage(pid, &ticks1, &rss1);
+	hz = sysconf(_SC_CLK_TCK);
+
+	for (i = 0; i < 3; i++) {
+		if ((times[i] = calloc(count, sizeof *times[i])) == NULL)
+			err(1, "calloc");
+	}
+	for (i = 0; i < count; i++) {
+		snprintf(target, sizeof target, "s%d", i % sessions);
+		times[0][i] = command("list-windows", "-t", target, NULL);
+		snprintf(target, sizeof target, "s%d:%d.%d", i % sessions,
+		    i % windows, i % panes);
+		times[1][i] = command("select-pane", "-t", target, NULL);
+		times[2][i] = command("send-keys", "-t", target, "x", NULL);
+	}
+
+	printf("%d sessions, %d windows, %d panes (%d total), %d clients, "
+	    "output every %dms\n", sessions, windows, panes, total, nclients,
+	    interval);
+	printf("%-14s %llu kB, %.1f kB per pane\n", "memory", rss1,
+	    total > 1 ? (double) (rss1 - rss0) / (total - 1) : 0.0);
+	printf("%-14s %.2f%% over %d seconds\n", "cpu",
+	    100.0 * (ticks1 - ticks0) / hz / seconds, seconds);
+	report("list-windows", times[0], count);
+	report("select-pane", times[1], count);
+	report("send-keys", times[2], count);
+
+	return (0);
+
+usage:
+	fprintf(stderr, "usage: scale [-c clients] [-i interval] [-n count] "
+	    "[-p panes] [-s sessions] [-t seconds] [-w windows] tmux\n");
+	return (1);
+}
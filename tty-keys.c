@@ -581,8 +581,11 @@ handle_key:
 	if (event_initialized(&tty->key_timer))
 		evtimer_del(&tty->key_timer);
 
-	if (key != KEYC_NONE)
+	if (key != KEYC_NONE) {
+		if (gettimeofday(&tty->key_time, NULL) != 0)
+			fatal("gettimeofday failed");
 		server_client_handle_key(tty->client, key);
+	}
 
 	tty->flags &= ~TTY_ESCAPE;
 	return (1);
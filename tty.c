@@ -154,6 +154,7 @@ tty_open(struct tty *tty, const char *overrides, char **cause)
 
 	tty->event = bufferevent_new(
 	    tty->fd, tty_read_callback, NULL, tty_error_callback, tty);
+	bufferevent_priority_set(tty->event, EVENT_PRIORITY_INPUT);
 
 	tty_start_tty(tty);
 
@@ -167,9 +168,12 @@ void
 tty_read_callback(unused struct bufferevent *bufev, void *data)
 {
 	struct tty	*tty = data;
+	struct timeval	 tv;
 
+	stats_start(&tv);
 	while (tty_keys_next(tty))
 		;
+	stats_stop(STATS_CLIENT, &tv);
 }
 
 /* ARGSUSED */
@@ -375,12 +379,17 @@ tty_putcode_ptr2(struct tty *tty, enum tty_code_code code, const void *a, const
 void
 tty_puts(struct tty *tty, const char *s)
 {
+	size_t	len;
+
 	if (*s == '\0')
 		return;
-	bufferevent_write(tty->event, s, strlen(s));
+	len = strlen(s);
+	bufferevent_write(tty->event, s, len);
+	tty->bytes += len;
+	global_stats.tty_bytes += len;
 
 	if (tty->log_fd != -1)
-		write(tty->log_fd, s, strlen(s));
+		write(tty->log_fd, s, len);
 }
 
 void
@@ -388,15 +397,20 @@ tty_putc(struct tty *tty, u_char ch)
 {
 	const char	*acs;
 	u_int		 sx;
+	size_t		 len;
 
-	if (tty->cell.attr & GRID_ATTR_CHARSET) {
+	acs = NULL;
+	if (tty->cell.attr & GRID_ATTR_CHARSET)
 		acs = tty_acs_get(tty, ch);
-		if (acs != NULL)
-			bufferevent_write(tty->event, acs, strlen(acs));
-		else
-			bufferevent_write(tty->event, &ch, 1);
-	} else
+	if (acs != NULL) {
+		len = strlen(acs);
+		bufferevent_write(tty->event, acs, len);
+	} else {
+		len = 1;
 		bufferevent_write(tty->event, &ch, 1);
+	}
+	tty->bytes += len;
+	global_stats.tty_bytes += len;
 
 	if (ch >= 0x20 && ch != 0x7f) {
 		sx = tty->sx;
@@ -422,6 +436,8 @@ tty_pututf8(struct tty *tty, const struct grid_utf8 *gu)
 
 	size = grid_utf8_size(gu);
 	bufferevent_write(tty->event, gu->data, size);
+	tty->bytes += size;
+	global_stats.tty_bytes += size;
 	if (tty->log_fd != -1)
 		write(tty->log_fd, gu->data, size);
 	tty->cx += gu->width;
@@ -74,6 +74,9 @@ struct window_choose_mode_data {
 
 	void 			(*callbackfn)(struct window_choose_data *);
 	void			(*freefn)(struct window_choose_data *);
+
+	void			(*cancelfn)(void *);
+	void			*canceldata;
 };
 
 int     window_choose_key_index(struct window_choose_mode_data *, u_int);
@@ -119,6 +122,32 @@ window_choose_ready(struct window_pane *wp, u_int cur,
 	window_choose_collapse_all(wp);
 }
 
+/* Add an item to a list which is already shown. */
+void
+window_choose_append(struct window_pane *wp, struct window_choose_data *wcd)
+{
+	struct window_choose_mode_data	*data = wp->modedata;
+
+	window_choose_add(wp, wcd);
+	ARRAY_ADD(&data->old_list, ARRAY_LAST(&data->list));
+
+	window_choose_redraw_screen(wp);
+}
+
+/*
+ * Items are still being added to the list; cancelfn is called if the mode
+ * goes away first.
+ */
+void
+window_choose_background(struct window_pane *wp, void (*cancelfn)(void *),
+    void *canceldata)
+{
+	struct window_choose_mode_data	*data = wp->modedata;
+
+	data->cancelfn = cancelfn;
+	data->canceldata = canceldata;
+}
+
 struct screen *
 window_choose_init(struct window_pane *wp)
 {
@@ -130,6 +159,7 @@ window_choose_init(struct window_pane *wp)
 
 	data->callbackfn = NULL;
 	data->freefn = NULL;
+	data->cancelfn = NULL;
 	data->input_type = WINDOW_CHOOSE_NORMAL;
 	data->input_str = xstrdup("");
 	data->input_prompt = NULL;
@@ -179,6 +209,9 @@ window_choose_free(struct window_pane *wp)
 	struct window_choose_mode_item	*item;
 	u_int				 i;
 
+	if (data->cancelfn != NULL)
+		data->cancelfn(data->canceldata);
+
 	for (i = 0; i < ARRAY_LENGTH(&data->old_list); i++) {
 		item = &ARRAY_ITEM(&data->old_list, i);
 		if (data->freefn != NULL && item->wcd != NULL)
@@ -40,12 +40,9 @@ void	window_copy_write_lines(
 	    struct window_pane *, struct screen_write_ctx *, u_int, u_int);
 
 void	window_copy_scroll_to(struct window_pane *, u_int, u_int);
-int	window_copy_search_compare(
-	    struct grid *, u_int, u_int, struct grid *, u_int);
-int	window_copy_search_lr(
-	    struct grid *, struct grid *, u_int *, u_int, u_int, u_int);
-int	window_copy_search_rl(
-	    struct grid *, struct grid *, u_int *, u_int, u_int, u_int);
+int	window_copy_search_match(struct search_text *, size_t, size_t, void *);
+int	window_copy_search_update(struct window_pane *, const char *);
+u_int	window_copy_search_index(struct window_pane *, u_int, u_int);
 void	window_copy_search_up(struct window_pane *, const char *);
 void	window_copy_search_down(struct window_pane *, const char *);
 void	window_copy_goto_line(struct window_pane *, const char *);
@@ -97,6 +94,12 @@ enum window_copy_input_type {
 	WINDOW_COPY_GOTOLINE,
 };
 
+/* Position of a search match. */
+struct window_copy_match {
+	u_int		px;
+	u_int		py;
+};
+
 /*
  * Copy-mode's visible screen (the "screen" field) is filled from one of
  * two sources: the original contents of the pane (used when we
@@ -143,6 +146,14 @@ struct window_copy_mode_data {
 	enum window_copy_input_type searchtype;
 	char	       *searchstr;
 
+	/*
+	 * Every match of the last search, in order. They are found again only
+	 * if the search or the backing grid changes.
+	 */
+	struct search	search;
+	ARRAY_DECL(, struct window_copy_match) matches;
+	unsigned long long matchgen; /* grid generation when found */
+
 	enum window_copy_input_type jumptype;
 	char		jumpchar;
 };
@@ -174,6 +185,9 @@ window_copy_init(struct window_pane *wp)
 	data->searchtype = WINDOW_COPY_OFF;
 	data->searchstr = NULL;
 
+	data->search.string = NULL;
+	ARRAY_INIT(&data->matches);
+
 	if (wp->fd != -1)
 		bufferevent_disable(wp->event, EV_READ|EV_WRITE);
 
@@ -237,12 +251,16 @@ window_copy_free(struct window_pane *wp)
 {
 	struct window_copy_mode_data	*data = wp->modedata;
 
+	/* Reading is started again once the mode is gone. */
 	if (wp->fd != -1)
-		bufferevent_enable(wp->event, EV_READ|EV_WRITE);
+		bufferevent_enable(wp->event, EV_WRITE);
 
 	free(data->searchstr);
 	free(data->inputstr);
 
+	search_free(&data->search);
+	ARRAY_FREE(&data->matches);
+
 	if (data->backing != &wp->base) {
 		screen_free(data->backing);
 		free(data->backing);
@@ -903,189 +921,142 @@ window_copy_scroll_to(struct window_pane *wp, u_int px, u_int py)
 	window_copy_redraw_screen(wp);
 }
 
+/* Add a match to the list. */
+/* ARGSUSED */
 int
-window_copy_search_compare(
-    struct grid *gd, u_int px, u_int py, struct grid *sgd, u_int spx)
+window_copy_search_match(struct search_text *st, size_t off,
+    unused size_t size, void *data)
 {
-	const struct grid_cell	*gc, *sgc;
-	const struct grid_utf8	*gu, *sgu;
+	struct window_copy_mode_data	*wdata = data;
+	struct window_copy_match	 m;
 
-	gc = grid_peek_cell(gd, px, py);
-	sgc = grid_peek_cell(sgd, spx, 0);
-
-	if ((gc->flags & GRID_FLAG_UTF8) != (sgc->flags & GRID_FLAG_UTF8))
-		return (0);
-
-	if (gc->flags & GRID_FLAG_UTF8) {
-		gu = grid_peek_utf8(gd, px, py);
-		sgu = grid_peek_utf8(sgd, spx, 0);
-		if (grid_utf8_compare(gu, sgu))
-			return (1);
-	} else {
-		if (gc->data == sgc->data)
-			return (1);
-	}
+	m.px = st->px[off];
+	m.py = st->py[off];
+	ARRAY_ADD(&wdata->matches, m);
 	return (0);
 }
 
+/*
+ * Find every match in the backing screen, unless the matches for this search
+ * string are already known and nothing has changed since.
+ */
 int
-window_copy_search_lr(struct grid *gd,
-    struct grid *sgd, u_int *ppx, u_int py, u_int first, u_int last)
+window_copy_search_update(struct window_pane *wp, const char *searchstr)
 {
-	u_int	ax, bx, px;
+	struct window_copy_mode_data	*data = wp->modedata;
+	struct grid			*gd = data->backing->grid;
+	struct search			*sr = &data->search;
+	struct client			*c;
+	int				 flags;
+	char				*cause;
+	u_int				 i;
 
-	for (ax = first; ax < last; ax++) {
-		if (ax + sgd->sx >= gd->sx)
-			break;
-		for (bx = 0; bx < sgd->sx; bx++) {
-			px = ax + bx;
-			if (!window_copy_search_compare(gd, px, py, sgd, bx))
-				break;
-		}
-		if (bx == sgd->sx) {
-			*ppx = ax;
-			return (1);
+	flags = 0;
+	if (options_get_number(&wp->window->options, "regex-search"))
+		flags |= SEARCH_REGEX;
+
+	if (sr->string != NULL &&
+	    sr->flags == flags &&
+	    strcmp(sr->string, searchstr) == 0) {
+		if (data->matchgen == gd->generation)
+			return (0);
+	} else {
+		search_free(sr);
+		if (search_compile(sr, searchstr, flags, &cause) != 0) {
+			for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
+				c = ARRAY_ITEM(&clients, i);
+				if (c == NULL || c->session == NULL)
+					continue;
+				if (c->session->curw->window == wp->window)
+					status_message_set(c, "%s", cause);
+			}
+			free(cause);
+			return (-1);
 		}
 	}
+
+	ARRAY_CLEAR(&data->matches);
+	search_grid(sr, gd, window_copy_search_match, data);
+
+	data->matchgen = gd->generation;
 	return (0);
 }
 
-int
-window_copy_search_rl(struct grid *gd,
-    struct grid *sgd, u_int *ppx, u_int py, u_int first, u_int last)
+/* Find the index of the first match at or after a position. */
+u_int
+window_copy_search_index(struct window_pane *wp, u_int px, u_int py)
 {
-	u_int	ax, bx, px;
-
-	for (ax = last + 1; ax > first; ax--) {
-		if (gd->sx - (ax - 1) < sgd->sx)
-			continue;
-		for (bx = 0; bx < sgd->sx; bx++) {
-			px = ax - 1 + bx;
-			if (!window_copy_search_compare(gd, px, py, sgd, bx))
-				break;
-		}
-		if (bx == sgd->sx) {
-			*ppx = ax - 1;
-			return (1);
-		}
+	struct window_copy_mode_data	*data = wp->modedata;
+	struct window_copy_match	*m;
+	u_int				 lo, hi, mid;
+
+	lo = 0;
+	hi = ARRAY_LENGTH(&data->matches);
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		m = &ARRAY_ITEM(&data->matches, mid);
+		if (m->py < py || (m->py == py && m->px < px))
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
-	return (0);
+	return (lo);
 }
 
 void
 window_copy_search_up(struct window_pane *wp, const char *searchstr)
 {
 	struct window_copy_mode_data	*data = wp->modedata;
-	struct screen			*s = data->backing, ss;
-	struct screen_write_ctx		 ctx;
-	struct grid			*gd = s->grid, *sgd;
-	struct grid_cell	 	 gc;
-	size_t				 searchlen;
-	u_int				 i, last, fx, fy, px;
-	int				 utf8flag, n, wrapped, wrapflag;
+	struct grid			*gd = data->backing->grid;
+	struct window_copy_match	*m;
+	u_int				 i, fx, fy;
 
 	if (*searchstr == '\0')
 		return;
-	utf8flag = options_get_number(&wp->window->options, "utf8");
-	wrapflag = options_get_number(&wp->window->options, "wrap-search");
-	searchlen = screen_write_strlen(utf8flag, "%s", searchstr);
-
-	screen_init(&ss, searchlen, 1, 0);
-	screen_write_start(&ctx, NULL, &ss);
-	memcpy(&gc, &grid_default_cell, sizeof gc);
-	screen_write_nputs(&ctx, -1, &gc, utf8flag, "%s", searchstr);
-	screen_write_stop(&ctx);
+	if (window_copy_search_update(wp, searchstr) != 0)
+		return;
+	if (ARRAY_EMPTY(&data->matches))
+		return;
 
 	fx = data->cx;
 	fy = gd->hsize - data->oy + data->cy;
 
-	if (fx == 0) {
-		if (fy == 0)
+	i = window_copy_search_index(wp, fx, fy);
+	if (i == 0) {
+		if (!options_get_number(&wp->window->options, "wrap-search"))
 			return;
-		fx = gd->sx - 1;
-		fy--;
-	} else
-		fx--;
-	n = wrapped = 0;
-
-retry:
-	sgd = ss.grid;
-	for (i = fy + 1; i > 0; i--) {
-		last = screen_size_x(s);
-		if (i == fy + 1)
-			last = fx;
-		n = window_copy_search_rl(gd, sgd, &px, i - 1, 0, last);
-		if (n) {
-			window_copy_scroll_to(wp, px, i - 1);
-			break;
-		}
-	}
-	if (wrapflag && !n && !wrapped) {
-		fx = gd->sx - 1;
-		fy = gd->hsize + gd->sy - 1;
-		wrapped = 1;
-		goto retry;
+		i = ARRAY_LENGTH(&data->matches);
 	}
-
-	screen_free(&ss);
+	m = &ARRAY_ITEM(&data->matches, i - 1);
+	window_copy_scroll_to(wp, m->px, m->py);
 }
 
 void
 window_copy_search_down(struct window_pane *wp, const char *searchstr)
 {
 	struct window_copy_mode_data	*data = wp->modedata;
-	struct screen			*s = data->backing, ss;
-	struct screen_write_ctx		 ctx;
-	struct grid			*gd = s->grid, *sgd;
-	struct grid_cell	 	 gc;
-	size_t				 searchlen;
-	u_int				 i, first, fx, fy, px;
-	int				 utf8flag, n, wrapped, wrapflag;
+	struct grid			*gd = data->backing->grid;
+	struct window_copy_match	*m;
+	u_int				 i, fx, fy;
 
 	if (*searchstr == '\0')
 		return;
-	utf8flag = options_get_number(&wp->window->options, "utf8");
-	wrapflag = options_get_number(&wp->window->options, "wrap-search");
-	searchlen = screen_write_strlen(utf8flag, "%s", searchstr);
-
-	screen_init(&ss, searchlen, 1, 0);
-	screen_write_start(&ctx, NULL, &ss);
-	memcpy(&gc, &grid_default_cell, sizeof gc);
-	screen_write_nputs(&ctx, -1, &gc, utf8flag, "%s", searchstr);
-	screen_write_stop(&ctx);
+	if (window_copy_search_update(wp, searchstr) != 0)
+		return;
+	if (ARRAY_EMPTY(&data->matches))
+		return;
 
 	fx = data->cx;
 	fy = gd->hsize - data->oy + data->cy;
 
-	if (fx == gd->sx - 1) {
-		if (fy == gd->hsize + gd->sy)
+	i = window_copy_search_index(wp, fx + 1, fy);
+	if (i == ARRAY_LENGTH(&data->matches)) {
+		if (!options_get_number(&wp->window->options, "wrap-search"))
 			return;
-		fx = 0;
-		fy++;
-	} else
-		fx++;
-	n = wrapped = 0;
-
-retry:
-	sgd = ss.grid;
-	for (i = fy + 1; i < gd->hsize + gd->sy + 1; i++) {
-		first = 0;
-		if (i == fy + 1)
-			first = fx;
-		n = window_copy_search_lr(gd, sgd, &px, i - 1, first, gd->sx);
-		if (n) {
-			window_copy_scroll_to(wp, px, i - 1);
-			break;
-		}
+		i = 0;
 	}
-	if (wrapflag && !n && !wrapped) {
-		fx = 0;
-		fy = 0;
-		wrapped = 1;
-		goto retry;
-	}
-
-	screen_free(&ss);
+	m = &ARRAY_ITEM(&data->matches, i);
+	window_copy_scroll_to(wp, m->px, m->py);
 }
 
 void
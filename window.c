@@ -21,7 +21,6 @@
 
 #include <errno.h>
 #include <fcntl.h>
-#include <fnmatch.h>
 #include <pwd.h>
 #include <signal.h>
 #include <stdlib.h>
@@ -60,7 +59,15 @@ u_int	next_window_id;
 
 void	window_pane_timer_callback(int, short, void *);
 void	window_pane_read_callback(struct bufferevent *, void *);
+void	window_pane_input_callback(int, short, void *);
+void	window_pane_input_pause(struct window_pane *);
 void	window_pane_error_callback(struct bufferevent *, short, void *);
+int	window_pane_find_match(struct search_text *, size_t, size_t, void *);
+
+struct window_pane_find_data {
+	char	*line;
+	u_int	 py;
+};
 
 RB_GENERATE(winlinks, winlink, entry, winlink_cmp);
 
@@ -290,6 +297,8 @@ window_create1(u_int sx, u_int sy)
 	options_init(&w->options, &global_w_options);
 	if (options_get_number(&w->options, "automatic-rename"))
 		queue_window_name(w);
+	w->content = NULL;
+	window_update_content(w);
 
 	for (i = 0; i < ARRAY_LENGTH(&windows); i++) {
 		if (ARRAY_ITEM(&windows, i) == NULL) {
@@ -346,8 +355,10 @@ window_destroy(struct window *w)
 		evtimer_del(&w->name_timer);
 
 	options_free(&w->options);
+	content_free(w->content);
 
 	window_destroy_panes(w);
+	screen_redraw_invalidate(w);
 
 	free(w->name);
 	free(w);
@@ -363,6 +374,21 @@ window_remove_ref(struct window *w)
 		window_destroy(w);
 }
 
+/* Compile the monitor-content patterns and start matching again. */
+void
+window_update_content(struct window *w)
+{
+	struct window_pane	*wp;
+
+	content_free(w->content);
+	w->content = content_create(options_get_string(&w->options,
+	    "monitor-content"));
+	w->flags &= ~WINDOW_CONTENT;
+
+	TAILQ_FOREACH(wp, &w->panes, entry)
+		wp->content_state = 0;
+}
+
 void
 window_set_name(struct window *w, const char *new_name)
 {
@@ -376,6 +402,7 @@ window_resize(struct window *w, u_int sx, u_int sy)
 {
 	w->sx = sx;
 	w->sy = sy;
+	screen_redraw_invalidate(w);
 }
 
 void
@@ -484,6 +511,7 @@ window_remove_pane(struct window *w, struct window_pane *wp)
 
 	TAILQ_REMOVE(&w->panes, wp, entry);
 	window_pane_destroy(wp);
+	screen_redraw_invalidate(w);
 }
 
 struct window_pane *
@@ -629,14 +657,17 @@ window_pane_create(struct window *w, u_int sx, u_int sy, u_int hlimit)
 	wp->sx = sx;
 	wp->sy = sy;
 
-	wp->pipe_fd = -1;
+	TAILQ_INIT(&wp->pipes);
 	wp->pipe_off = 0;
-	wp->pipe_event = NULL;
+
+	wp->record = NULL;
+	wp->replay = NULL;
 
 	wp->saved_grid = NULL;
 
 	screen_init(&wp->base, sx, sy, hlimit);
 	wp->screen = &wp->base;
+	window_pane_update_index(wp);
 
 	input_init(wp);
 
@@ -650,6 +681,8 @@ window_pane_destroy(struct window_pane *wp)
 
 	if (event_initialized(&wp->changes_timer))
 		evtimer_del(&wp->changes_timer);
+	if (event_initialized(&wp->input_timer))
+		evtimer_del(&wp->input_timer);
 
 	if (wp->fd != -1) {
 		bufferevent_free(wp->event);
@@ -662,10 +695,10 @@ window_pane_destroy(struct window_pane *wp)
 	if (wp->saved_grid != NULL)
 		grid_destroy(wp->saved_grid);
 
-	if (wp->pipe_fd != -1) {
-		bufferevent_free(wp->pipe_event);
-		close(wp->pipe_fd);
-	}
+	pipe_close_all(wp);
+	record_stop(wp);
+	replay_stop(wp);
+	control_remove_pane(wp);
 
 	RB_REMOVE(window_pane_tree, &all_window_panes, wp);
 
@@ -680,14 +713,17 @@ window_pane_spawn(struct window_pane *wp, const char *cmd, const char *shell,
     const char *cwd, struct environ *env, struct termios *tio, char **cause)
 {
 	struct winsize	 ws;
-	char		*argv0, paneid[16];
+	struct spawn	 sp;
+	char		*argv0, *argv[4], paneid[16];
 	const char	*ptr;
-	struct termios	 tio2;
+	int		 utf8;
 
 	if (wp->fd != -1) {
 		bufferevent_free(wp->event);
 		close(wp->fd);
 	}
+	if (event_initialized(&wp->input_timer))
+		evtimer_del(&wp->input_timer);
 	if (cmd != NULL) {
 		free(wp->cmd);
 		wp->cmd = xstrdup(cmd);
@@ -705,62 +741,53 @@ window_pane_spawn(struct window_pane *wp, const char *cmd, const char *shell,
 	ws.ws_col = screen_size_x(&wp->base);
 	ws.ws_row = screen_size_y(&wp->base);
 
-	switch (wp->pid = forkpty(&wp->fd, wp->tty, NULL, &ws)) {
-	case -1:
-		wp->fd = -1;
-		xasprintf(cause, "%s: %s", cmd, strerror(errno));
-		return (-1);
-	case 0:
-		if (chdir(wp->cwd) != 0)
-			chdir("/");
-
-		if (tcgetattr(STDIN_FILENO, &tio2) != 0)
-			fatal("tcgetattr failed");
-		if (tio != NULL)
-			memcpy(tio2.c_cc, tio->c_cc, sizeof tio2.c_cc);
-		tio2.c_cc[VERASE] = '\177';
-#ifdef IUTF8
-		if (options_get_number(&wp->window->options, "utf8"))
-			tio2.c_iflag |= IUTF8;
-#endif
-		if (tcsetattr(STDIN_FILENO, TCSANOW, &tio2) != 0)
-			fatal("tcgetattr failed");
-
-		closefrom(STDERR_FILENO + 1);
-
-		xsnprintf(paneid, sizeof paneid, "%%%u", wp->id);
-		environ_set(env, "TMUX_PANE", paneid);
-		environ_push(env);
+	xsnprintf(paneid, sizeof paneid, "%%%u", wp->id);
+	environ_set(env, "TMUX_PANE", paneid);
+	environ_set(env, "SHELL", wp->shell);
 
-		clear_signals(1);
-		log_close();
-
-		setenv("SHELL", wp->shell, 1);
-		ptr = strrchr(wp->shell, '/');
+	ptr = strrchr(wp->shell, '/');
+	if (ptr != NULL && *(ptr + 1) != '\0')
+		ptr++;
+	else
+		ptr = wp->shell;
+	if (*wp->cmd != '\0') {
+		/* Use the command. */
+		argv0 = xstrdup(ptr);
+		argv[1] = xstrdup("-c");
+		argv[2] = wp->cmd;
+		argv[3] = NULL;
+	} else {
+		/* No command; fork a login shell. */
+		xasprintf(&argv0, "-%s", ptr);
+		argv[1] = NULL;
+	}
+	argv[0] = argv0;
 
-		if (*wp->cmd != '\0') {
-			/* Use the command. */
-			if (ptr != NULL && *(ptr + 1) != '\0')
-				xasprintf(&argv0, "%s", ptr + 1);
-			else
-				xasprintf(&argv0, "%s", wp->shell);
-			execl(wp->shell, argv0, "-c", wp->cmd, (char *) NULL);
-			fatal("execl failed");
-		}
+	memset(&sp, 0, sizeof sp);
+	sp.path = wp->shell;
+	sp.argv = argv;
+	sp.envp = environ_array(env);
+	sp.cwd = wp->cwd;
 
-		/* No command; fork a login shell. */
-		if (ptr != NULL && *(ptr + 1) != '\0')
-			xasprintf(&argv0, "-%s", ptr + 1);
-		else
-			xasprintf(&argv0, "-%s", wp->shell);
-		execl(wp->shell, argv0, (char *) NULL);
-		fatal("execl failed");
+	utf8 = options_get_number(&wp->window->options, "utf8");
+	wp->pid = spawn_pane(&sp, &wp->fd, wp->tty, &ws, tio, utf8);
+	if (wp->pid == -1) {
+		wp->fd = -1;
+		xasprintf(cause, "%s: %s", cmd, strerror(errno));
 	}
 
+	environ_free_array(sp.envp);
+	free(argv0);
+	if (argv[1] != NULL)
+		free(argv[1]);
+	if (wp->pid == -1)
+		return (-1);
+
 	setblocking(wp->fd, 0);
 
 	wp->event = bufferevent_new(wp->fd,
 	    window_pane_read_callback, NULL, window_pane_error_callback, wp);
+	bufferevent_priority_set(wp->event, EVENT_PRIORITY_OUTPUT);
 	bufferevent_enable(wp->event, EV_READ|EV_WRITE);
 
 	return (0);
@@ -808,16 +835,25 @@ void
 window_pane_read_callback(unused struct bufferevent *bufev, void *data)
 {
 	struct window_pane     *wp = data;
-	char   		       *new_data;
+	u_char		       *new_data;
 	size_t			new_size;
+	struct timeval		tv;
 
-	new_size = EVBUFFER_LENGTH(wp->event->input) - wp->pipe_off;
-	if (wp->pipe_fd != -1 && new_size > 0) {
-		new_data = EVBUFFER_DATA(wp->event->input);
-		bufferevent_write(wp->pipe_event, new_data, new_size);
-	}
+	stats_start(&tv);
 
-	input_parse(wp);
+	new_size = EVBUFFER_LENGTH(wp->event->input) - wp->pipe_off;
+	wp->bytes += new_size;
+	global_stats.pane_bytes += new_size;
+	new_data = EVBUFFER_DATA(wp->event->input) + wp->pipe_off;
+	if (!TAILQ_EMPTY(&wp->pipes) && new_size > 0)
+		pipe_write(wp, new_data, new_size);
+	if (wp->record != NULL)
+		record_data(wp, new_data, new_size);
+
+	if (input_parse(wp) != 0)
+		window_pane_input_pause(wp);
+	if (wp->flags & PANE_KEYECHO)
+		server_client_key_echo(wp);
 
 	wp->pipe_off = EVBUFFER_LENGTH(wp->event->input);
 
@@ -828,6 +864,70 @@ window_pane_read_callback(unused struct bufferevent *bufev, void *data)
 	wp->window->flags |= WINDOW_SILENCE;
 	if (gettimeofday(&wp->window->silence_timer, NULL) != 0)
 		fatal("gettimeofday failed.");
+
+	stats_stop(STATS_PANE, &tv);
+}
+
+/*
+ * Stop reading from the pane while there is input left over and parse the rest
+ * on the next loop, so that one busy pane cannot hold up everything else.
+ */
+void
+window_pane_input_pause(struct window_pane *wp)
+{
+	struct timeval	tv;
+
+	bufferevent_disable(wp->event, EV_READ);
+
+	timerclear(&tv);
+	evtimer_set(&wp->input_timer, window_pane_input_callback, wp);
+	event_priority_set(&wp->input_timer, EVENT_PRIORITY_OUTPUT);
+	evtimer_add(&wp->input_timer, &tv);
+}
+
+/*
+ * Start reading from the pane again unless something still wants it stopped:
+ * copy mode (so the screen does not move under it), left over input waiting
+ * for the next loop, or a pipe which is catching up.
+ */
+void
+window_pane_update_read(struct window_pane *wp)
+{
+	if (wp->fd == -1 || wp->event == NULL)
+		return;
+	if (wp->mode == &window_copy_mode)
+		return;
+	if (event_initialized(&wp->input_timer) &&
+	    evtimer_pending(&wp->input_timer, NULL))
+		return;
+	if (wp->flags & PANE_PIPEPAUSE)
+		return;
+	bufferevent_enable(wp->event, EV_READ);
+}
+
+/* ARGSUSED */
+void
+window_pane_input_callback(unused int fd, unused short events, void *data)
+{
+	struct window_pane	*wp = data;
+	struct timeval		 tv;
+
+	stats_start(&tv);
+
+	if (input_parse(wp) != 0)
+		window_pane_input_pause(wp);
+	else
+		window_pane_update_read(wp);
+	if (wp->flags & PANE_KEYECHO)
+		server_client_key_echo(wp);
+
+	wp->pipe_off = EVBUFFER_LENGTH(wp->event->input);
+
+	wp->window->flags |= WINDOW_SILENCE;
+	if (gettimeofday(&wp->window->silence_timer, NULL) != 0)
+		fatal("gettimeofday failed.");
+
+	stats_stop(STATS_PANE, &tv);
 }
 
 /* ARGSUSED */
@@ -857,6 +957,8 @@ window_pane_resize(struct window_pane *wp, u_int sx, u_int sy)
 	screen_resize(&wp->base, sx, sy);
 	if (wp->mode != NULL)
 		wp->mode->resize(wp, sx, sy);
+	if (wp->record != NULL)
+		record_resize(wp);
 
 	if (wp->fd != -1 && ioctl(wp->fd, TIOCSWINSZ, &ws) == -1)
 #ifdef __sun
@@ -975,6 +1077,7 @@ window_pane_reset_mode(struct window_pane *wp)
 
 	wp->mode->free(wp);
 	wp->mode = NULL;
+	window_pane_update_read(wp);
 
 	wp->screen = &wp->base;
 	wp->flags |= PANE_REDRAW;
@@ -1041,29 +1144,46 @@ window_pane_visible(struct window_pane *wp)
 	return (1);
 }
 
+/* Start, stop or resize the history index to match the search-index option. */
+void
+window_pane_update_index(struct window_pane *wp)
+{
+	size_t	limit;
+
+	limit = options_get_number(&wp->window->options, "search-index");
+	grid_index_set(wp->base.grid, limit * 1024);
+}
+
+/* Remember the line of a match. */
+/* ARGSUSED */
+int
+window_pane_find_match(struct search_text *st, size_t off,
+    unused size_t size, void *data)
+{
+	struct window_pane_find_data	*fd = data;
+
+	fd->py = st->py[off];
+	free(fd->line);
+	fd->line = xstrdup(st->buf);
+	return (1);
+}
+
+/*
+ * Search the history and screen of a pane and return the text of the last
+ * (most recent) line which matches, or NULL.
+ */
 char *
-window_pane_search(struct window_pane *wp, const char *searchstr, u_int *lineno)
+window_pane_find(struct window_pane *wp, struct search *sr, u_int *lineno)
 {
-	struct screen	*s = &wp->base;
-	char		*newsearchstr, *line, *msg;
-	u_int	 	 i;
-
-	msg = NULL;
-	xasprintf(&newsearchstr, "*%s*", searchstr);
-
-	for (i = 0; i < screen_size_y(s); i++) {
-		line = grid_view_string_cells(s->grid, 0, i, screen_size_x(s));
-		if (fnmatch(newsearchstr, line, 0) == 0) {
-			msg = line;
-			if (lineno != NULL)
-				*lineno = i;
-			break;
-		}
-		free(line);
-	}
+	struct window_pane_find_data	fd;
+
+	fd.line = NULL;
+	fd.py = 0;
+	search_grid(sr, wp->base.grid, window_pane_find_match, &fd);
 
-	free(newsearchstr);
-	return (msg);
+	if (fd.line != NULL && lineno != NULL)
+		*lineno = fd.py;
+	return (fd.line);
 }
 
 /* Find the pane directly above another. */